@@ -56,6 +56,7 @@ pkg_config_packs := gio-2.0 \
                     x11 \
                     xinerama \
                     xext \
+                    xfixes \
                     "xrandr >= 1.5" \
                     xscrnsaver \
 
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "draw.h"
 #include "dunst.h"
 #include "log.h"
 #include "menu.h"
@@ -136,6 +137,12 @@ int cmp_methods(const void *vkey, const void *velem)
         return strcmp(key, m->method_name);
 }
 
+static void ingest_call(const struct dbus_method *m,
+                        GDBusConnection *connection,
+                        const gchar *sender,
+                        GVariant *parameters,
+                        GDBusMethodInvocation *invocation);
+
 DBUS_METHOD(Notify);
 DBUS_METHOD(CloseNotification);
 DBUS_METHOD(GetCapabilities);
@@ -164,7 +171,7 @@ void dbus_cb_fdn_methods(GDBusConnection *connection,
                                         cmp_methods);
 
         if (m) {
-                m->method(connection, sender, parameters, invocation);
+                ingest_call(m, connection, sender, parameters, invocation);
         } else {
                 LOG_M("Unknown method name: '%s' (sender: '%s').",
                       method_name,
@@ -214,7 +221,7 @@ void dbus_cb_dunst_methods(GDBusConnection *connection,
                                         cmp_methods);
 
         if (m) {
-                m->method(connection, sender, parameters, invocation);
+                ingest_call(m, connection, sender, parameters, invocation);
         } else {
                 LOG_M("Unknown method name: '%s' (sender: '%s').",
                       method_name,
@@ -522,7 +529,18 @@ static void dbus_cb_GetCapabilities(
         g_dbus_connection_flush(connection, NULL, NULL, NULL);
 }
 
-static struct notification *dbus_message_to_notification(const gchar *sender, GVariant *parameters)
+/**
+ * Unpack the parameters of a Notify call into a new notification. This only
+ * looks at the message and leaves the rules to dbus_notification_prepare().
+ *
+ * @param hints_ret return location for the hints of the message
+ * @param icon_ret return location for the raw icon of the message or NULL
+ * @returns NULL, if the parameters have the wrong type
+ */
+static struct notification *dbus_message_decode(const gchar *sender,
+                                                GVariant *parameters,
+                                                GVariant **hints_ret,
+                                                GVariant **icon_ret)
 {
         /* Assert that the parameters' type is actually correct. Albeit usually DBus
          * already rejects ill typed parameters, it may not be always the case. */
@@ -652,17 +670,27 @@ static struct notification *dbus_message_to_notification(const gchar *sender, GV
         if (timeout >= 0)
                 n->dbus_timeout = ((gint64)timeout) * 1000;
 
+        g_variant_type_free(required_type);
+        g_free(actions); // the strv is only a shallow copy
+
+        *hints_ret = hints;
+        *icon_ret = icon_value;
+        return n;
+}
+
+/**
+ * Apply the rules to the decoded notification \p n and set the hints, which
+ * override them. The raw icon is left to the caller. Consumes \p hints.
+ */
+static void dbus_notification_prepare(struct notification *n, GVariant *hints)
+{
+        GVariant *dict_value;
+
         // All attributes that have to be set before initializations are set,
         // so we can initialize the notification. This applies all rules that
         // are defined and applies the formatting to the message.
         notification_init(n);
 
-        if (icon_value) {
-                if (n->receiving_raw_icon)
-                        notification_icon_replace_data(n, icon_value);
-                g_variant_unref(icon_value);
-        }
-
         // Modify these values after the notification is initialized and all rules are applied.
         if ((dict_value = g_variant_lookup_value(hints, "fgcolor", G_VARIANT_TYPE_STRING))) {
                 g_free(n->colors.fg);
@@ -688,10 +716,6 @@ static struct notification *dbus_message_to_notification(const gchar *sender, GV
         }
 
         g_variant_unref(hints);
-        g_variant_type_free(required_type);
-        g_free(actions); // the strv is only a shallow copy
-
-        return n;
 }
 
 void signal_length_propertieschanged()
@@ -761,22 +785,167 @@ void signal_length_propertieschanged()
         g_clear_pointer(&invalidated_builder, g_variant_builder_unref);
 }
 
-static void dbus_cb_Notify(
-                GDBusConnection *connection,
-                const gchar *sender,
-                GVariant *parameters,
-                GDBusMethodInvocation *invocation)
+/*
+ * Notify applies the rules on the main loop and hands the notification to
+ * the ingest thread, which loads its icon. The loaded notifications get
+ * handed back to the main loop, which owns the queues. It inserts them and
+ * replies to the callers with the ids.
+ *
+ * All calls get answered in the order they arrived. Other methods, which
+ * arrive while notifications are still loading, wait for them.
+ */
+enum ingest_state {
+        INGEST_QUEUED,                  /**< the rules aren't applied yet */
+        INGEST_LOADING,                 /**< on the ingest thread */
+        INGEST_LOADED,
+};
+
+struct ingest_job {
+        struct ingest_job *next;        /**< next loaded job, see ingest_list_push() */
+        const struct dbus_method *method; /**< the waiting method or NULL for Notify */
+        GDBusMethodInvocation *invocation; /**< NULL, once it got answered */
+        enum ingest_state state;
+        struct notification *n;         /**< NULL, if it failed to decode */
+        GVariant *icon_value;           /**< the raw icon or NULL */
+        double scale;                   /**< the scale to load the icon at */
+        bool load_icon;
+};
+
+struct ingest {
+        GSource source;
+        GThreadPool *pool;
+        struct ingest_job *done;        /**< loaded jobs, newest first */
+        GQueue calls;                   /**< all unanswered jobs, oldest first */
+};
+
+static struct ingest *ingest = NULL;
+
+/**
+ * Add \p job to the list at \p head. Safe to call from any thread.
+ */
+static void ingest_list_push(struct ingest_job **head, struct ingest_job *job)
+{
+        do {
+                job->next = g_atomic_pointer_get(head);
+        } while (!g_atomic_pointer_compare_and_exchange(head, job->next, job));
+}
+
+/**
+ * Empty the list at \p head. Only a single thread may take from a list.
+ *
+ * @returns the jobs in the order they were pushed
+ */
+static struct ingest_job *ingest_list_take(struct ingest_job **head)
+{
+        struct ingest_job *job;
+        do {
+                job = g_atomic_pointer_get(head);
+        } while (job && !g_atomic_pointer_compare_and_exchange(head, job, NULL));
+
+        struct ingest_job *ordered = NULL;
+        while (job) {
+                struct ingest_job *next = job->next;
+                job->next = ordered;
+                ordered = job;
+                job = next;
+        }
+        return ordered;
+}
+
+static void ingest_worker(gpointer data, gpointer user_data)
+{
+        struct ingest_job *job = data;
+        struct notification *n = job->n;
+
+        // The ingest thread must not talk to the display server
+        draw_pin_scale(&job->scale);
+
+        if (job->icon_value && n->receiving_raw_icon) {
+                notification_icon_replace_data(n, job->icon_value);
+        } else if (job->load_icon && n->iconname && !n->icon) {
+                notification_icon_replace_path(n, n->iconname);
+                n->icon_searched = true;
+        }
+
+        draw_pin_scale(NULL);
+        g_clear_pointer(&job->icon_value, g_variant_unref);
+
+        ingest_list_push(&ingest->done, job);
+        g_main_context_wakeup(NULL);
+}
+
+/**
+ * Apply the rules to the queued notifications from \p link on and hand them
+ * to the ingest thread. Stops at the first other method, as it may change
+ * the rules for the notifications behind it.
+ */
+static void ingest_start(GList *link)
 {
-        struct notification *n = dbus_message_to_notification(sender, parameters);
-        if (!n) {
-                LOG_W("A notification failed to decode.");
-                g_dbus_method_invocation_return_dbus_error(
-                                invocation,
-                                FDN_IFAC".Error",
-                                "Cannot decode notification!");
+        for (; link; link = link->next) {
+                struct ingest_job *job = link->data;
+                if (job->method)
+                        break;
+                if (job->state != INGEST_QUEUED)
+                        continue;
+
+                GDBusMethodInvocation *invocation = job->invocation;
+                GVariant *hints;
+                job->n = dbus_message_decode(
+                                g_dbus_method_invocation_get_sender(invocation),
+                                g_dbus_method_invocation_get_parameters(invocation),
+                                &hints, &job->icon_value);
+
+                if (!job->n) {
+                        LOG_W("A notification failed to decode.");
+                        g_dbus_method_invocation_return_dbus_error(
+                                        invocation,
+                                        FDN_IFAC".Error",
+                                        "Cannot decode notification!");
+                        job->invocation = NULL;
+                        job->state = INGEST_LOADED;
+                        continue;
+                }
+
+                dbus_notification_prepare(job->n, hints);
+
+                // Updates usually keep their icon, so don't load it again
+                struct notification *old = job->n->id ? queues_get_by_id(job->n->id) : NULL;
+                job->load_icon = !(old && old->icon && STR_EQ(old->iconname, job->n->iconname));
+                job->scale = draw_get_scale();
+
+                job->state = INGEST_LOADING;
+                g_thread_pool_push(ingest->pool, job, NULL);
+        }
+}
+
+/**
+ * Insert the notification of \p job into the queues and reply to the caller
+ * with its id. If \p accept is false, the call gets rejected instead.
+ * Frees \p job.
+ */
+static void ingest_finish(struct ingest_job *job, bool accept)
+{
+        struct notification *n = job->n;
+        GDBusMethodInvocation *invocation = job->invocation;
+
+        g_free(job);
+
+        if (!accept) {
+                if (invocation)
+                        g_dbus_method_invocation_return_dbus_error(
+                                        invocation,
+                                        FDN_IFAC".Error",
+                                        "The notification daemon is shutting down");
+                if (n)
+                        notification_unref(n);
                 return;
         }
 
+        // It failed to decode and got answered already
+        if (!n)
+                return;
+
+        GDBusConnection *connection = g_dbus_method_invocation_get_connection(invocation);
         int id = queues_notification_insert(n);
 
         GVariant *reply = g_variant_new("(u)", id);
@@ -788,8 +957,127 @@ static void dbus_cb_Notify(
                 signal_notification_closed(n, REASON_USER);
                 notification_unref(n);
         }
+}
+
+/**
+ * Answer the calls at the head of the queue, until one of them has to wait
+ * for the ingest thread.
+ */
+static void ingest_advance(void)
+{
+        struct ingest_job *job;
+        while ((job = g_queue_peek_head(&ingest->calls))) {
+                if (job->method) {
+                        g_queue_pop_head(&ingest->calls);
+                        GDBusMethodInvocation *invocation = job->invocation;
+                        job->method->method(g_dbus_method_invocation_get_connection(invocation),
+                                            g_dbus_method_invocation_get_sender(invocation),
+                                            g_dbus_method_invocation_get_parameters(invocation),
+                                            invocation);
+                        g_free(job);
+                        continue;
+                }
+
+                ingest_start(g_queue_peek_head_link(&ingest->calls));
+                if (job->state != INGEST_LOADED)
+                        break;
+
+                g_queue_pop_head(&ingest->calls);
+                ingest_finish(job, true);
+        }
+}
+
+/**
+ * Call the method \p m right away, unless notifications that arrived before
+ * are still loading. Then it waits for them.
+ */
+static void ingest_call(const struct dbus_method *m,
+                        GDBusConnection *connection,
+                        const gchar *sender,
+                        GVariant *parameters,
+                        GDBusMethodInvocation *invocation)
+{
+        if (m->method == dbus_cb_Notify || g_queue_is_empty(&ingest->calls)) {
+                m->method(connection, sender, parameters, invocation);
+                return;
+        }
+
+        struct ingest_job *job = g_malloc0(sizeof(struct ingest_job));
+        job->method = m;
+        job->invocation = invocation; // answered in ingest_advance()
+        g_queue_push_tail(&ingest->calls, job);
+}
+
+static gboolean ingest_prepare(GSource *source, gint *timeout)
+{
+        *timeout = -1;
+        return g_atomic_pointer_get(&((struct ingest *)source)->done) != NULL;
+}
+
+static gboolean ingest_check(GSource *source)
+{
+        return g_atomic_pointer_get(&((struct ingest *)source)->done) != NULL;
+}
+
+static gboolean ingest_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+        struct ingest_job *job = ingest_list_take(&((struct ingest *)source)->done);
+
+        // The jobs stay in the calls queue, which keeps their order
+        for (; job; job = job->next)
+                job->state = INGEST_LOADED;
 
+        ingest_advance();
+
+        // Draw once for all notifications that arrived in the meantime
         wake_up();
+        return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs ingest_funcs = {
+        .prepare = ingest_prepare,
+        .check = ingest_check,
+        .dispatch = ingest_dispatch,
+};
+
+static void ingest_setup(void)
+{
+        ingest = (struct ingest *)g_source_new(&ingest_funcs, sizeof(struct ingest));
+        ingest->done = NULL;
+        g_queue_init(&ingest->calls);
+        // A single thread, which loads the icons one after another
+        ingest->pool = g_thread_pool_new(ingest_worker, NULL, 1, FALSE, NULL);
+        g_source_set_name(&ingest->source, "dunst ingest");
+        g_source_attach(&ingest->source, NULL);
+}
+
+static void ingest_teardown(void)
+{
+        // Wait for the loading notifications, but don't show them anymore
+        g_source_destroy(&ingest->source);
+        g_thread_pool_free(ingest->pool, FALSE, TRUE);
+        ingest_list_take(&ingest->done);
+
+        struct ingest_job *job;
+        while ((job = g_queue_pop_head(&ingest->calls)))
+                ingest_finish(job, false);
+
+        g_source_unref(&ingest->source);
+        ingest = NULL;
+}
+
+static void dbus_cb_Notify(
+                GDBusConnection *connection,
+                const gchar *sender,
+                GVariant *parameters,
+                GDBusMethodInvocation *invocation)
+{
+        struct ingest_job *job = g_malloc0(sizeof(struct ingest_job));
+        job->invocation = invocation; // replied to in ingest_finish()
+        job->state = INGEST_QUEUED;
+        g_queue_push_tail(&ingest->calls, job);
+
+        ingest_advance();
 }
 
 static void dbus_cb_CloseNotification(
@@ -1167,6 +1455,8 @@ int dbus_init(void)
         introspection_data = g_dbus_node_info_new_for_xml(introspection_xml,
                                                           NULL);
 
+        ingest_setup();
+
         owner_id = g_bus_own_name(G_BUS_TYPE_SESSION,
                                   FDN_NAME,
                                   G_BUS_NAME_OWNER_FLAGS_NONE,
@@ -1184,6 +1474,8 @@ void dbus_teardown(int owner_id)
         g_clear_pointer(&introspection_data, g_dbus_node_info_unref);
 
         g_bus_unown_name(owner_id);
+
+        ingest_teardown();
         dbus_conn = NULL;
 }
 
@@ -8,6 +8,7 @@
 #include <pango/pango-layout.h>
 #include <pango/pango-types.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <glib.h>
 
@@ -35,11 +36,17 @@ struct colored_layout {
         struct color bg;
         struct color highlight;
         struct color frame;
-        char *text;
+        char *text;            /**< text of the "(N more)" layout */
+        char *markup;          /**< the text_to_render the layout was created from */
+        int text_length;       /**< bytes of the markup's text handed to pango (-1: all) */
+        int text_tail_start;   /**< followed by the text's bytes in [tail_start, tail_end) (-1: none) */
+        int text_tail_end;
         PangoAttrList *attr;
         cairo_surface_t *icon;
         struct notification *n;
         bool is_xmore;
+        int layout_width;      /**< text width the layout got set up for (-1: not yet) */
+        double layout_scale;   /**< scale the layout got set up for */
 };
 
 const struct output *output;
@@ -47,6 +54,17 @@ window win;
 
 PangoFontDescription *pango_fdesc;
 
+/* The last drawn frame. When only the progress of the notifications changed
+ * since then, the layouts get reused and just the progress bars repainted. */
+static struct {
+        GSList *layouts;
+        cairo_surface_t *srf;  /**< referenced, to be sure it's not a new one */
+        struct dimensions dim;
+        double scale;
+        int dpi;               /**< resolution of the pango contexts of the layouts */
+        int hidden;            /**< displayed notifications, which didn't fit on the screen */
+} last_frame = { NULL, NULL, { 0 }, 0, 0, 0 };
+
 #define UINT_MAX_N(bits) ((1 << bits) - 1)
 
 void load_icon_themes()
@@ -228,6 +246,202 @@ static void layout_setup_pango(PangoLayout *layout, int width, int height,
         pango_layout_set_alignment(layout, alignment);
 }
 
+/* Font metrics of the layouts, to estimate how much of a text is visible.
+ * Looking them up takes a while, so cache them per font and resolution. */
+static struct {
+        const PangoFontDescription *fdesc;
+        double resolution;
+        int line_height;       /**< in pango units, including the line spacing */
+        int char_width;        /**< in pango units, of the narrowest likely glyphs */
+} layout_metrics = { NULL, 0, 0, 0 };
+
+// Characters passed to pango beyond the estimated visible ones
+#define LAYOUT_TEXT_MARGIN 64
+
+static gboolean attr_changes_font_size(PangoAttribute *attr, gpointer data)
+{
+        bool *changes = data;
+
+        switch (attr->klass->type) {
+        case PANGO_ATTR_SIZE:
+        case PANGO_ATTR_ABSOLUTE_SIZE:
+        case PANGO_ATTR_SCALE:
+                *changes = true;
+                break;
+        case PANGO_ATTR_FONT_DESC:
+                if (pango_font_description_get_set_fields(((PangoAttrFontDesc *)attr)->desc)
+                    & PANGO_FONT_MASK_SIZE)
+                        *changes = true;
+                break;
+        default:
+                break;
+        }
+
+        // Only look, keep the attribute in the list
+        return false;
+}
+
+// Estimate how many bytes of the text may be visible at most, when the
+// layout got set up with a limited height.
+// @param attr The attributes of the text (nullable)
+// @param width The available text width in pixels
+// @param height The maximum text height in pixels
+// @param tail_start Set to the start of the end of the last visible
+//        paragraph to shape as well, or -1
+// @param tail_end Set to the end of the last visible paragraph, or -1
+// @returns the length of the prefix to shape or -1 for the whole text
+static int layout_visible_length(PangoLayout *l, const char *text, PangoAttrList *attr,
+                                 int width, int height, PangoEllipsizeMode ellipsize,
+                                 double scale, int *tail_start, int *tail_end)
+{
+        *tail_start = -1;
+        *tail_end = -1;
+
+        PangoContext *context = pango_layout_get_context(l);
+        double resolution = pango_cairo_context_get_resolution(context);
+
+        if (layout_metrics.fdesc != pango_fdesc || layout_metrics.resolution != resolution) {
+                PangoFontMetrics *metrics = pango_context_get_metrics(context, pango_fdesc, NULL);
+
+                layout_metrics.fdesc = pango_fdesc;
+                layout_metrics.resolution = resolution;
+                layout_metrics.line_height = pango_font_metrics_get_ascent(metrics)
+                                             + pango_font_metrics_get_descent(metrics);
+                // Narrow glyphs like 'i' or '.' take up only a fraction
+                // of the average character width
+                layout_metrics.char_width = pango_font_metrics_get_approximate_char_width(metrics) / 4;
+
+                pango_font_metrics_unref(metrics);
+        }
+
+        int line_height = layout_metrics.line_height + round(settings.line_height * scale * PANGO_SCALE);
+        if (width <= 0 || height <= 0 || line_height <= 0 || layout_metrics.char_width <= 0)
+                return -1;
+
+        // Every line holds at least a newline and at most a line full of
+        // the narrowest glyphs
+        long lines = round(height * scale * PANGO_SCALE) / line_height + 1;
+        long chars_per_line = round(width * scale * PANGO_SCALE) / layout_metrics.char_width + 1;
+        long max_chars = lines * chars_per_line + LAYOUT_TEXT_MARGIN;
+
+        const char *end = text;
+        for (long i = 0; i < max_chars; i++) {
+                if (!*end)
+                        return -1;
+                end = g_utf8_next_char(end);
+        }
+
+        // The estimate only holds for text in the default font size
+        bool changes_font_size = false;
+        if (attr)
+                pango_attr_list_filter(attr, attr_changes_font_size, &changes_font_size);
+        if (changes_font_size)
+                return -1;
+
+        // Pango ellipsizes the rest of the last visible paragraph as a
+        // whole into its last line. Unless the end of the text is cut off,
+        // the end of this paragraph shows up after the ellipsis as well.
+        if (ellipsize != PANGO_ELLIPSIZE_END) {
+                const char *para_end = strchr(end, '\n');
+                if (!para_end)
+                        para_end = end + strlen(end);
+
+                const char *tail = para_end;
+                for (long i = 0; i < chars_per_line + LAYOUT_TEXT_MARGIN && tail > end; i++)
+                        tail = g_utf8_prev_char(tail);
+
+                if (tail > end) {
+                        *tail_start = tail - text;
+                        *tail_end = para_end - text;
+                } else if (!*para_end) {
+                        return -1;
+                } else {
+                        end = para_end;
+                }
+        }
+
+        return end - text;
+}
+
+struct attr_cut {
+        PangoAttrList *list;    /**< receives the moved attributes */
+        guint length;
+        guint tail_start;
+        guint tail_end;
+};
+
+// Map an index of the full text to the text with the middle cut out
+static guint attr_cut_index(const struct attr_cut *cut, guint index)
+{
+        if (index <= cut->length)
+                return index;
+        if (index <= cut->tail_start)
+                return cut->length;
+        return MIN(index, cut->tail_end) - (cut->tail_start - cut->length);
+}
+
+static gboolean attr_cut_copy(PangoAttribute *attr, gpointer data)
+{
+        struct attr_cut *cut = data;
+        guint start = attr_cut_index(cut, attr->start_index);
+        guint end = attr_cut_index(cut, attr->end_index);
+
+        if (start < end) {
+                PangoAttribute *copy = pango_attribute_copy(attr);
+                copy->start_index = start;
+                copy->end_index = end;
+                pango_attr_list_insert(cut->list, copy);
+        }
+
+        // Keep the attribute in the original list
+        return false;
+}
+
+// Hand only the text to pango, which may be visible at all. Shaping takes
+// time proportional to the length of the text, even when ellipsizing throws
+// most of it away afterwards.
+static void layout_limit_text(struct colored_layout *cl, int width, int height, double scale)
+{
+        // Without word wrap, the layout's height isn't limited
+        if (cl->is_xmore || !cl->n->word_wrap || cl->n->ellipsize == PANGO_ELLIPSIZE_NONE)
+                return;
+
+        const char *text;
+        PangoAttrList *attr;
+        notification_get_markup(cl->n, &text, &attr);
+
+        int tail_start, tail_end;
+        int length = layout_visible_length(cl->l, text, attr, width, height,
+                                           cl->n->ellipsize, scale, &tail_start, &tail_end);
+        if (length == cl->text_length
+            && tail_start == cl->text_tail_start
+            && tail_end == cl->text_tail_end)
+                return;
+
+        cl->text_length = length;
+        cl->text_tail_start = tail_start;
+        cl->text_tail_end = tail_end;
+
+        if (tail_start < 0) {
+                pango_layout_set_text(cl->l, text, length);
+                pango_layout_set_attributes(cl->l, attr);
+                return;
+        }
+
+        // Leave out the middle of the last visible paragraph, which
+        // disappears in the ellipsis anyway
+        GString *cut_text = g_string_new_len(text, length);
+        g_string_append_len(cut_text, text + tail_start, tail_end - tail_start);
+        pango_layout_set_text(cl->l, cut_text->str, cut_text->len);
+        g_string_free(cut_text, true);
+
+        struct attr_cut cut = { pango_attr_list_new(), length, tail_start, tail_end };
+        if (attr)
+                pango_attr_list_filter(attr, attr_cut_copy, &cut);
+        pango_layout_set_attributes(cl->l, cut.list);
+        pango_attr_list_unref(cut.list);
+}
+
 // Set up the layout of a single notification
 // @param width Width of the layout
 // @param height Height of the layout
@@ -236,9 +450,19 @@ static void layout_setup(struct colored_layout *cl, int width, int height, doubl
         int horizontal_padding = get_horizontal_text_icon_padding(cl->n);
         int icon_width = cl->icon ? get_icon_width(cl->icon, scale) + horizontal_padding : 0;
         int text_width = width - 2 * settings.h_padding - (cl->n->icon_position == ICON_TOP ? 0 : icon_width);
+
+        // The line breaking only depends on the text width. Keep the layout
+        // of the measuring pass, when the final width turns out to be the same.
+        if (cl->layout_width == text_width && cl->layout_scale == scale)
+                return;
+
+        cl->layout_width = text_width;
+        cl->layout_scale = scale;
+
         int progress_bar_height = have_progress_bar(cl) ? settings.progress_bar_height + settings.padding : 0;
         int max_text_height = MAX(0, settings.height - progress_bar_height - 2 * settings.padding);
         layout_setup_pango(cl->l, text_width, max_text_height, cl->n->word_wrap, cl->n->ellipsize, cl->n->alignment);
+        layout_limit_text(cl, text_width, max_text_height, scale);
 }
 
 static void free_colored_layout(void *data)
@@ -247,6 +471,9 @@ static void free_colored_layout(void *data)
         g_object_unref(cl->l);
         pango_attr_list_unref(cl->attr);
         g_free(cl->text);
+        g_free(cl->markup);
+        cairo_surface_destroy(cl->icon);
+        notification_unref(cl->n);
         g_free(cl);
 }
 
@@ -254,7 +481,11 @@ static void free_colored_layout(void *data)
 static struct dimensions calculate_notification_dimensions(struct colored_layout *cl, double scale)
 {
         struct dimensions dim = { 0 };
-        layout_setup(cl, settings.width.max, settings.height, scale);
+
+        // Measure with the width the content gets in render_content(), when
+        // the notification is as wide as possible. This way the common fixed
+        // width case can reuse the measured layout for rendering.
+        layout_setup(cl, settings.width.max + settings.frame_width, settings.height, scale);
 
         int horizontal_padding = get_horizontal_text_icon_padding(cl->n);
         int icon_width = cl->icon? get_icon_width(cl->icon, scale) + horizontal_padding : 0;
@@ -348,13 +579,22 @@ static struct colored_layout *layout_init_shared(cairo_t *c, struct notification
 {
         struct colored_layout *cl = g_malloc(sizeof(struct colored_layout));
         cl->l = layout_create(c);
+        cl->text = NULL;
+        cl->markup = NULL;
+        cl->text_length = -1;
+        cl->text_tail_start = -1;
+        cl->text_tail_end = -1;
+        cl->attr = NULL;
 
         cl->fg = string_to_color(n->colors.fg);
         cl->bg = string_to_color(n->colors.bg);
         cl->highlight = string_to_color(n->colors.highlight);
         cl->frame = string_to_color(n->colors.frame);
         cl->is_xmore = false;
+        cl->layout_width = -1;
+        cl->layout_scale = 0;
 
+        notification_ref(n);
         cl->n = n;
         return cl;
 }
@@ -363,51 +603,59 @@ static struct colored_layout *layout_derive_xmore(cairo_t *c, struct notificatio
 {
         struct colored_layout *cl = layout_init_shared(c, n);
         cl->text = g_strdup_printf("(%d more)", qlen);
-        cl->attr = NULL;
         cl->is_xmore = true;
         cl->icon = NULL;
         pango_layout_set_text(cl->l, cl->text, -1);
         return cl;
 }
 
-static struct colored_layout *layout_from_notification(cairo_t *c, struct notification *n)
+// Set the text of the layout to the text_to_render of the notification
+static void layout_set_markup(struct colored_layout *cl, struct notification *n)
 {
+        const char *text;
+        PangoAttrList *attr;
+        notification_get_markup(n, &text, &attr);
 
-        struct colored_layout *cl = layout_init_shared(c, n);
+        g_free(cl->markup);
+        pango_attr_list_unref(cl->attr);
+        cl->markup = g_strdup(n->text_to_render);
+        cl->attr = pango_attr_list_ref(attr);
 
-        if (n->icon_position != ICON_OFF && n->icon) {
-                cl->icon = n->icon;
-        } else {
-                cl->icon = NULL;
-        }
+        pango_layout_set_text(cl->l, text, -1);
+        pango_layout_set_attributes(cl->l, cl->attr);
 
-        /* markup */
-        GError *err = NULL;
-        pango_parse_markup(n->text_to_render, -1, 0, &(cl->attr), &(cl->text), NULL, &err);
+        // The visible part of the new text has to be determined again
+        cl->text_length = -1;
+        cl->text_tail_start = -1;
+        cl->text_tail_end = -1;
+        cl->layout_width = -1;
+}
 
-        if (!err) {
-                pango_layout_set_text(cl->l, cl->text, -1);
-                pango_layout_set_attributes(cl->l, cl->attr);
-        } else {
-                /* remove markup and display plain message instead */
-                n->text_to_render = markup_strip(n->text_to_render);
-                cl->text = NULL;
-                cl->attr = NULL;
-                pango_layout_set_text(cl->l, n->text_to_render, -1);
-                if (n->first_render) {
-                        LOG_W("Unable to parse markup: %s", err->message);
-                }
-                g_error_free(err);
-        }
+static cairo_surface_t *layout_get_icon(const struct notification *n)
+{
+        if (n->icon_position != ICON_OFF && n->icon)
+                return n->icon;
+        else
+                return NULL;
+}
 
-        n->first_render = false;
+static struct colored_layout *layout_from_notification(cairo_t *c, struct notification *n)
+{
+
+        struct colored_layout *cl = layout_init_shared(c, n);
+
+        // Keep the icon alive for comparing it in the next frame
+        cl->icon = layout_get_icon(n);
+        if (cl->icon)
+                cairo_surface_reference(cl->icon);
+
+        layout_set_markup(cl, n);
         return cl;
 }
 
-static GSList *create_layouts(cairo_t *c)
+// Update the text_to_render of all displayed notifications
+static void update_texts_to_render(void)
 {
-        GSList *layouts = NULL;
-
         int qlen = queues_length_waiting();
         bool xmore_is_needed = qlen > 0 && settings.indicate_hidden;
 
@@ -423,14 +671,63 @@ static GSList *create_layouts(cairo_t *c)
                         g_free(n->text_to_render);
                         n->text_to_render = new_ttr;
                 }
-                layouts = g_slist_append(layouts,
-                                layout_from_notification(c, n));
         }
+}
+
+/**
+ * Determine what the "(N more)" indicator has to show.
+ *
+ * @param hidden The displayed notifications, which don't fit on the screen
+ * @param count Set to the amount of notifications the indicator stands for
+ * @returns the notification the indicator takes its colors from or NULL, if
+ *          there is no indicator
+ */
+static struct notification *layout_get_xmore(const GList *hidden, int *count)
+{
+        int qlen = queues_length_waiting();
+        *count = qlen + g_list_length((GList *)hidden);
+
+        if (!settings.indicate_hidden || *count == 0)
+                return NULL;
 
-        if (xmore_is_needed && settings.notification_limit != 1) {
+        // With a limit of 1, the count is part of the notification's text
+        if (!hidden && settings.notification_limit == 1)
+                return NULL;
+
+        return qlen > 0 ? queues_get_head_waiting() : hidden->data;
+}
+
+static GSList *create_layouts(cairo_t *c)
+{
+        GSList *layouts = NULL;
+
+        // Only lay out the notifications, which fit on the screen. The rest
+        // is folded into the "(N more)" indicator.
+        double scale = output->get_scale();
+        int max_height = output->get_active_screen()->h / scale;
+        int height = 2 * settings.frame_width;
+
+        const GList *iter;
+        for (iter = queues_get_displayed(); iter; iter = iter->next) {
+                if (layouts && height > max_height)
+                        break;
+
+                struct colored_layout *cl = layout_from_notification(c, iter->data);
+                layouts = g_slist_append(layouts, cl);
+
+                height += calculate_notification_dimensions(cl, scale).h;
+                if (settings.gap_size)
+                        height += settings.gap_size + 2 * settings.frame_width;
+                else
+                        height += settings.separator_height;
+        }
+
+        int count;
+        struct notification *xmore = layout_get_xmore(iter, &count);
+        if (xmore) {
                 /* append xmore message as new message */
                 layouts = g_slist_append(layouts,
-                        layout_derive_xmore(c, queues_get_head_waiting(), qlen));
+                        layout_derive_xmore(c, xmore, count));
         }
 
         return layouts;
@@ -562,6 +859,125 @@ static void draw_rect(cairo_t *c, double x, double y, double width, double heigh
         cairo_rectangle(c, round(x * scale), round(y * scale), round(width * scale), round(height * scale));
 }
 
+static bool color_eq(struct color a, struct color b)
+{
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+/* The backgrounds rendered for the last frames. Usually the notifications
+ * share their size and colors, so painting the cached background is enough
+ * instead of filling the rounded paths again for every one of them. */
+#define BACKGROUND_CACHE_SIZE 8
+
+struct background {
+        int width;
+        int height;             /**< including the frame and separator */
+        int inner_height;       /**< the height without them */
+        int corner_radius;
+        int frame_width;
+        double scale;
+        double offset;          /**< subpixel part of the position on the surface */
+        bool first;
+        bool last;
+        struct color frame;
+        struct color bg;
+        cairo_surface_t *srf;
+};
+
+static GQueue background_cache = G_QUEUE_INIT;
+
+static bool background_eq(const struct background *a, const struct background *b)
+{
+        return a->width == b->width
+            && a->height == b->height
+            && a->inner_height == b->inner_height
+            && a->corner_radius == b->corner_radius
+            && a->frame_width == b->frame_width
+            && a->scale == b->scale
+            && a->offset == b->offset
+            && a->first == b->first
+            && a->last == b->last
+            && color_eq(a->frame, b->frame)
+            && color_eq(a->bg, b->bg);
+}
+
+static void background_free(void *data)
+{
+        struct background *bg = data;
+        cairo_surface_destroy(bg->srf);
+        g_free(bg);
+}
+
+static void background_cache_clear(void)
+{
+        struct background *bg;
+        while ((bg = g_queue_pop_head(&background_cache)))
+                background_free(bg);
+}
+
+static void background_render(struct background *bg)
+{
+        double scale = bg->scale;
+        float y = bg->offset / scale;
+
+        bg->srf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                             round(bg->width * scale),
+                                             ceil(bg->offset + round(bg->height * scale)));
+        cairo_t *c = cairo_create(bg->srf);
+
+        /* stroke area doesn't intersect with main area */
+        cairo_set_fill_rule(c, CAIRO_FILL_RULE_EVEN_ODD);
+
+        /* for correct combination of adjacent areas */
+        cairo_set_operator(c, CAIRO_OPERATOR_ADD);
+
+        draw_rounded_rect(c, 0, y, bg->width, bg->height, bg->corner_radius, scale, bg->first, bg->last);
+
+        /* adding frame */
+        int x = bg->frame_width;
+        if (bg->first)
+                y += bg->frame_width;
+        int width = bg->width - 2 * bg->frame_width;
+        int radius_int = frame_internal_radius(bg->corner_radius, bg->frame_width, bg->inner_height);
+
+        draw_rounded_rect(c, x, y, width, bg->inner_height, radius_int, scale, bg->first, bg->last);
+        cairo_set_source_rgba(c, bg->frame.r, bg->frame.g, bg->frame.b, bg->frame.a);
+        cairo_fill(c);
+
+        draw_rounded_rect(c, x, y, width, bg->inner_height, radius_int, scale, bg->first, bg->last);
+        cairo_set_source_rgba(c, bg->bg.r, bg->bg.g, bg->bg.b, bg->bg.a);
+        cairo_fill(c);
+
+        cairo_destroy(c);
+}
+
+/**
+ * Look up the background described by \p key in the cache and render it,
+ * if it's not in there yet.
+ *
+ * @returns the background, owned by the cache
+ */
+static const struct background *background_get(const struct background *key)
+{
+        for (GList *iter = background_cache.head; iter; iter = iter->next) {
+                if (background_eq(iter->data, key)) {
+                        g_queue_unlink(&background_cache, iter);
+                        g_queue_push_head_link(&background_cache, iter);
+                        return iter->data;
+                }
+        }
+
+        struct background *bg = g_malloc(sizeof(struct background));
+        *bg = *key;
+        background_render(bg);
+
+        g_queue_push_head(&background_cache, bg);
+        if (g_queue_get_length(&background_cache) > BACKGROUND_CACHE_SIZE)
+                background_free(g_queue_pop_tail(&background_cache));
+
+        return bg;
+}
+
 static cairo_surface_t *render_background(cairo_surface_t *srf,
                                           struct colored_layout *cl,
                                           struct colored_layout *cl_next,
@@ -575,15 +991,22 @@ static cairo_surface_t *render_background(cairo_surface_t *srf,
                                           double scale)
 {
         int x = 0;
-        int radius_int = corner_radius;
-
-        cairo_t *c = cairo_create(srf);
-
-        /* stroke area doesn't intersect with main area */
-        cairo_set_fill_rule(c, CAIRO_FILL_RULE_EVEN_ODD);
-
-        /* for correct combination of adjacent areas */
-        cairo_set_operator(c, CAIRO_OPERATOR_ADD);
+        struct background key = {
+                .width = width,
+                .corner_radius = corner_radius,
+                .frame_width = settings.frame_width,
+                .scale = scale,
+                .first = first,
+                .last = last,
+                .frame = cl->frame,
+                .bg = cl->bg,
+        };
+
+        // Render the background at the same subpixel position, so it
+        // only has to be moved by whole pixels
+        float y_scaled = y * scale;
+        double top = floor(y_scaled);
+        key.offset = y_scaled - top;
 
         if (first)
                 height += settings.frame_width;
@@ -592,7 +1015,7 @@ static cairo_surface_t *render_background(cairo_surface_t *srf,
         else
                 height += settings.separator_height;
 
-        draw_rounded_rect(c, x, y, width, height, corner_radius, scale, first, last);
+        key.height = height;
 
         /* adding frame */
         x += settings.frame_width;
@@ -608,14 +1031,19 @@ static cairo_surface_t *render_background(cairo_surface_t *srf,
         else
                 height -= settings.separator_height;
 
-        radius_int = frame_internal_radius(corner_radius, settings.frame_width, height);
+        key.inner_height = height;
 
-        draw_rounded_rect(c, x, y, width, height, radius_int, scale, first, last);
-        cairo_set_source_rgba(c, cl->frame.r, cl->frame.g, cl->frame.b, cl->frame.a);
-        cairo_fill(c);
+        const struct background *bg = background_get(&key);
 
-        draw_rounded_rect(c, x, y, width, height, radius_int, scale, first, last);
-        cairo_set_source_rgba(c, cl->bg.r, cl->bg.g, cl->bg.b, cl->bg.a);
+        cairo_t *c = cairo_create(srf);
+
+        /* for correct combination of adjacent areas */
+        cairo_set_operator(c, CAIRO_OPERATOR_ADD);
+
+        cairo_set_source_surface(c, bg->srf, 0, top);
+        cairo_rectangle(c, 0, top,
+                        cairo_image_surface_get_width(bg->srf),
+                        cairo_image_surface_get_height(bg->srf));
         cairo_fill(c);
 
         cairo_set_operator(c, CAIRO_OPERATOR_SOURCE);
@@ -641,10 +1069,83 @@ static cairo_surface_t *render_background(cairo_surface_t *srf,
                                                   round(width * scale), round(height * scale));
 }
 
+/**
+ * Draw the progress bar of a layout.
+ *
+ * @param h The height of the layout, see layout_get_height()
+ * @param repaint Paint the background underneath first, to draw over the
+ *                progress bar of a previous frame
+ */
+static void render_progress_bar(cairo_t *c, struct colored_layout *cl, int width, int h, double scale, bool repaint)
+{
+        int progress = MIN(cl->n->progress, 100);
+        unsigned int frame_x = 0;
+        unsigned int frame_width = settings.progress_bar_frame_width,
+                     progress_width = MIN(width - 2 * settings.h_padding, settings.progress_bar_max_width),
+                     progress_height = settings.progress_bar_height - frame_width,
+                     frame_y = settings.padding + h - settings.progress_bar_height,
+                     progress_width_without_frame = progress_width - 2 * frame_width,
+                     progress_width_1 = progress_width_without_frame * progress / 100,
+                     progress_width_2 = progress_width_without_frame - progress_width_1;
+
+        switch (cl->n->progress_bar_alignment) {
+                case PANGO_ALIGN_LEFT:
+                     frame_x = settings.h_padding;
+                     break;
+                case PANGO_ALIGN_CENTER:
+                     frame_x = width/2 - progress_width/2;
+                     break;
+                case PANGO_ALIGN_RIGHT:
+                     frame_x = width - progress_width - settings.h_padding;
+                     break;
+        }
+        unsigned int x_bar_1 = frame_x + frame_width,
+                     x_bar_2 = x_bar_1 + progress_width_1;
+
+        double half_frame_width = frame_width / 2.0;
+
+        if (repaint) {
+                cairo_set_operator(c, CAIRO_OPERATOR_SOURCE);
+                cairo_set_source_rgba(c, cl->bg.r, cl->bg.g, cl->bg.b, cl->bg.a);
+                draw_rect(c, frame_x, frame_y, progress_width, settings.progress_bar_height, scale);
+                cairo_fill(c);
+                cairo_set_operator(c, CAIRO_OPERATOR_OVER);
+        }
+
+        /* Draw progress bar
+        * TODO: Modify draw_rounde_rect to fix blurry lines due to fractional scaling
+        * Note: the bar could be drawn a bit smaller, because the frame is drawn on top 
+        */
+        // left side (fill)
+        cairo_set_source_rgba(c, cl->highlight.r, cl->highlight.g, cl->highlight.b, cl->highlight.a);
+        draw_rounded_rect(c, x_bar_1, frame_y, progress_width_1, progress_height, 
+                settings.progress_bar_corner_radius, scale, true, true);
+        cairo_fill(c);
+        // right side (background)
+        cairo_set_source_rgba(c, cl->bg.r, cl->bg.g, cl->bg.b, cl->bg.a);
+        draw_rounded_rect(c, x_bar_2, frame_y, progress_width_2, progress_height, 
+                settings.progress_bar_corner_radius, scale, true, true);
+
+        cairo_fill(c);
+
+        // border
+        cairo_set_source_rgba(c, cl->frame.r, cl->frame.g, cl->frame.b, cl->frame.a);
+        cairo_set_line_width(c, frame_width * scale);
+        draw_rounded_rect(c,
+                        frame_x + half_frame_width,
+                        frame_y + half_frame_width,
+                        progress_width - frame_width,
+                        progress_height,
+                        settings.progress_bar_corner_radius,
+                        scale, true, true);
+        cairo_stroke(c);
+}
+
 static void render_content(cairo_t *c, struct colored_layout *cl, int width, double scale)
 {
         // Redo layout setup, while knowing the width. This is to make
-        // alignment work correctly
+        // alignment work correctly. It's a noop, when the width is the same
+        // as the measured one.
         layout_setup(cl, width, settings.height, scale);
 
         const int h = layout_get_height(cl, scale);
@@ -715,62 +1216,31 @@ static void render_content(cairo_t *c, struct colored_layout *cl, int width, dou
                 cairo_fill(c);
         }
 
-        // progress bar positioning
-        if (have_progress_bar(cl)) {
-                int progress = MIN(cl->n->progress, 100);
-                unsigned int frame_x = 0;
-                unsigned int frame_width = settings.progress_bar_frame_width,
-                             progress_width = MIN(width - 2 * settings.h_padding, settings.progress_bar_max_width),
-                             progress_height = settings.progress_bar_height - frame_width,
-                             frame_y = settings.padding + h - settings.progress_bar_height,
-                             progress_width_without_frame = progress_width - 2 * frame_width,
-                             progress_width_1 = progress_width_without_frame * progress / 100,
-                             progress_width_2 = progress_width_without_frame - progress_width_1;
-
-                switch (cl->n->progress_bar_alignment) {
-                        case PANGO_ALIGN_LEFT:
-                             frame_x = settings.h_padding;
-                             break;
-                        case PANGO_ALIGN_CENTER:
-                             frame_x = width/2 - progress_width/2;
-                             break;
-                        case PANGO_ALIGN_RIGHT:
-                             frame_x = width - progress_width - settings.h_padding;
-                             break;
-                }
-                unsigned int x_bar_1 = frame_x + frame_width,
-                             x_bar_2 = x_bar_1 + progress_width_1;
-
-                double half_frame_width = frame_width / 2.0;
-
-                /* Draw progress bar
-                * TODO: Modify draw_rounde_rect to fix blurry lines due to fractional scaling
-                * Note: the bar could be drawn a bit smaller, because the frame is drawn on top 
-                */
-                // left side (fill)
-                cairo_set_source_rgba(c, cl->highlight.r, cl->highlight.g, cl->highlight.b, cl->highlight.a);
-                draw_rounded_rect(c, x_bar_1, frame_y, progress_width_1, progress_height, 
-                        settings.progress_bar_corner_radius, scale, true, true);
-                cairo_fill(c);
-                // right side (background)
-                cairo_set_source_rgba(c, cl->bg.r, cl->bg.g, cl->bg.b, cl->bg.a);
-                draw_rounded_rect(c, x_bar_2, frame_y, progress_width_2, progress_height, 
-                        settings.progress_bar_corner_radius, scale, true, true);
+        if (have_progress_bar(cl))
+                render_progress_bar(c, cl, width, h, scale, false);
+}
 
-                cairo_fill(c);
+// Calculate where the layout following a layout of height \p cl_h starts
+static int layout_next_y(int y, int cl_h, bool first, bool last)
+{
+        /* adding frame */
+        if (first)
+                y += settings.frame_width;
 
-                // border
-                cairo_set_source_rgba(c, cl->frame.r, cl->frame.g, cl->frame.b, cl->frame.a);
-                cairo_set_line_width(c, frame_width * scale);
-                draw_rounded_rect(c,
-                                frame_x + half_frame_width,
-                                frame_y + half_frame_width,
-                                progress_width - frame_width,
-                                progress_height,
-                                settings.progress_bar_corner_radius,
-                                scale, true, true);
-                cairo_stroke(c);
-        }
+        if (last)
+                y += settings.frame_width;
+
+        if ((2 * settings.padding + cl_h) < settings.height)
+                y += cl_h + 2 * settings.padding;
+        else
+                y += settings.height;
+
+        if (settings.gap_size)
+                y += settings.gap_size;
+        else
+                y += settings.separator_height;
+
+        return y;
 }
 
 static struct dimensions layout_render(cairo_surface_t *srf,
@@ -794,25 +1264,45 @@ static struct dimensions layout_render(cairo_surface_t *srf,
 
         render_content(c, cl, bg_width, scale);
 
-        /* adding frame */
-        if (first)
-                dim.y += settings.frame_width;
+        dim.y = layout_next_y(dim.y, cl_h, first, last);
 
-        if (last)
-                dim.y += settings.frame_width;
+        cairo_destroy(c);
+        cairo_surface_destroy(content);
+        return dim;
+}
 
-        if ((2 * settings.padding + cl_h) < settings.height)
-                dim.y += cl_h + 2 * settings.padding;
-        else
-                dim.y += settings.height;
+/**
+ * Repaint only the progress bar of a layout, which got rendered into \p srf
+ * by layout_render() before.
+ */
+static struct dimensions layout_render_progress(cairo_surface_t *srf,
+                                                struct colored_layout *cl,
+                                                struct dimensions dim,
+                                                bool first,
+                                                bool last)
+{
+        double scale = output->get_scale();
+        const int cl_h = layout_get_height(cl, scale);
 
-        if (settings.gap_size)
-                dim.y += settings.gap_size;
-        else
-                dim.y += settings.separator_height;
+        if (have_progress_bar(cl)) {
+                // The content area render_background() returns
+                int x = settings.frame_width;
+                int y = dim.y + (first ? settings.frame_width : 0);
+                int width = dim.w - 2 * settings.frame_width;
+                int height = MIN(settings.height, (2 * settings.padding) + cl_h);
 
-        cairo_destroy(c);
-        cairo_surface_destroy(content);
+                cairo_surface_t *content = cairo_surface_create_for_rectangle(srf,
+                                round(x * scale), round(y * scale),
+                                round(width * scale), round(height * scale));
+                cairo_t *c = cairo_create(content);
+
+                render_progress_bar(c, cl, width, cl_h, scale, true);
+
+                cairo_destroy(c);
+                cairo_surface_destroy(content);
+        }
+
+        dim.y = layout_next_y(dim.y, cl_h, first, last);
         return dim;
 }
 
@@ -866,6 +1356,130 @@ void calc_window_pos(const struct screen_info *scr, int width, int height, int *
         }
 }
 
+/**
+ * Check if the layout \p cl can be reused to draw \p n. Apart from the
+ * text, everything affecting the looks of the notification has to match.
+ */
+static bool layout_fits(const struct colored_layout *cl, const struct notification *n, bool xmore)
+{
+        if (cl->is_xmore != xmore)
+                return false;
+
+        if (!color_eq(cl->fg, string_to_color(n->colors.fg))
+            || !color_eq(cl->bg, string_to_color(n->colors.bg))
+            || !color_eq(cl->highlight, string_to_color(n->colors.highlight))
+            || !color_eq(cl->frame, string_to_color(n->colors.frame)))
+                return false;
+
+        if (xmore)
+                return true;
+
+        const struct notification *old = cl->n;
+        return cl->icon == layout_get_icon(n)
+            && old->icon_position == n->icon_position
+            && old->hide_text == n->hide_text
+            && old->word_wrap == n->word_wrap
+            && old->ellipsize == n->ellipsize
+            && old->alignment == n->alignment
+            && old->progress_bar_alignment == n->progress_bar_alignment
+            && old->urgency == n->urgency
+            && (old->progress >= 0) == (n->progress >= 0);
+}
+
+static void layout_set_notification(struct colored_layout *cl, struct notification *n)
+{
+        notification_ref(n);
+        notification_unref(cl->n);
+        cl->n = n;
+}
+
+/**
+ * Take over the layouts of the last frame, if the notifications to draw only
+ * differ from it in their text and progress.
+ *
+ * @param text_changed Set to true, if the text of a layout got updated
+ * @returns the layouts, or NULL if they have to be created from scratch
+ */
+static GSList *reuse_layouts(bool *text_changed)
+{
+        GSList *layouts = last_frame.layouts;
+        if (!layouts)
+                return NULL;
+
+        // The layouts keep the resolution of the screen they got created on
+        if (last_frame.dpi != output->get_active_screen()->dpi)
+                return NULL;
+
+        GSList *cl_iter = layouts;
+        const GList *iter = queues_get_displayed();
+        bool texts_changed = false;
+        for (; iter && cl_iter; iter = iter->next, cl_iter = cl_iter->next) {
+                struct colored_layout *cl = cl_iter->data;
+                struct notification *n = iter->data;
+
+                if (cl->is_xmore)
+                        break;
+                if (!layout_fits(cl, n, false))
+                        return NULL;
+                if (!STR_EQ(cl->markup, n->text_to_render))
+                        texts_changed = true;
+        }
+
+        // The notifications left over don't fit on the screen, if they
+        // didn't last time either. But with other texts, the heights and so
+        // the amount of notifications fitting on the screen may change.
+        const GList *hidden = iter;
+        if (hidden && (texts_changed || !last_frame.hidden))
+                return NULL;
+
+        int count;
+        struct notification *xmore = layout_get_xmore(hidden, &count);
+        if (xmore) {
+                if (!cl_iter || !layout_fits(cl_iter->data, xmore, true))
+                        return NULL;
+                cl_iter = cl_iter->next;
+        }
+        if (cl_iter)
+                return NULL;
+
+        *text_changed = texts_changed;
+        iter = queues_get_displayed();
+        for (cl_iter = layouts; iter != hidden; iter = iter->next, cl_iter = cl_iter->next) {
+                struct colored_layout *cl = cl_iter->data;
+                struct notification *n = iter->data;
+
+                layout_set_notification(cl, n);
+                if (!STR_EQ(cl->markup, n->text_to_render))
+                        layout_set_markup(cl, n);
+        }
+        if (xmore) {
+                struct colored_layout *cl = cl_iter->data;
+                char *text = g_strdup_printf("(%d more)", count);
+
+                layout_set_notification(cl, xmore);
+                if (!STR_EQ(cl->text, text)) {
+                        g_free(cl->text);
+                        cl->text = text;
+                        pango_layout_set_text(cl->l, cl->text, -1);
+                        *text_changed = true;
+                } else {
+                        g_free(text);
+                }
+        }
+
+        last_frame.layouts = NULL;
+        return layouts;
+}
+
+static void last_frame_clear(void)
+{
+        g_slist_free_full(last_frame.layouts, free_colored_layout);
+        last_frame.layouts = NULL;
+        if (last_frame.srf)
+                cairo_surface_destroy(last_frame.srf);
+        last_frame.srf = NULL;
+}
+
 void draw(void)
 {
         assert(queues_length_displayed() > 0);
@@ -876,15 +1490,58 @@ void draw(void)
                 return;
         }
 
-        GSList *layouts = create_layouts(c);
+        update_texts_to_render();
+
+        bool text_changed = true;
+        GSList *layouts = reuse_layouts(&text_changed);
+        if (!layouts)
+                layouts = create_layouts(c);
 
         struct dimensions dim = calculate_dimensions(layouts);
         LOG_D("Window dimensions %ix%i", dim.w, dim.h);
         double scale = output->get_scale();
 
-        cairo_surface_t *image_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-                                                                    round(dim.w * scale),
-                                                                    round(dim.h * scale));
+        // Draw straight into the surface the output is going to present,
+        // instead of a temporary one that needs to be copied over.
+        cairo_surface_t *image_surface = output->win_get_surface(win,
+                                                                 round(dim.w * scale),
+                                                                 round(dim.h * scale));
+
+        if (!image_surface) {
+                g_slist_free_full(layouts, free_colored_layout);
+                last_frame_clear();
+                return;
+        }
+
+        // If only the progress changed and the surface still holds the last
+        // frame, there is no need to draw anything but the progress bars.
+        bool progress_only = !text_changed
+                             && image_surface == last_frame.srf
+                             && scale == last_frame.scale
+                             && dim.w == last_frame.dim.w
+                             && dim.h == last_frame.dim.h;
+
+        last_frame_clear();
+        last_frame.layouts = layouts;
+        last_frame.srf = cairo_surface_reference(image_surface);
+        last_frame.dim = dim;
+        last_frame.scale = scale;
+        last_frame.dpi = output->get_active_screen()->dpi;
+        last_frame.hidden = queues_length_displayed();
+        for (GSList *iter = layouts; iter; iter = iter->next) {
+                if (!((struct colored_layout *)iter->data)->is_xmore)
+                        last_frame.hidden--;
+        }
+
+        if (progress_only) {
+                LOG_D("Repainting progress bars only");
+        } else {
+                // The surface may still hold the previous frame
+                cairo_t *clear = cairo_create(image_surface);
+                cairo_set_operator(clear, CAIRO_OPERATOR_CLEAR);
+                cairo_paint(clear);
+                cairo_destroy(clear);
+        }
 
         bool first = true;
         bool last;
@@ -899,27 +1556,41 @@ void draw(void)
                         last = true;
                 }
 
-                dim = layout_render(image_surface, cl_this, cl_next, dim, first, last);
+                if (progress_only)
+                        dim = layout_render_progress(image_surface, cl_this, dim, first, last);
+                else
+                        dim = layout_render(image_surface, cl_this, cl_next, dim, first, last);
 
                 first = false;
         }
 
         output->display_surface(image_surface, win, &dim);
-
-        cairo_surface_destroy(image_surface);
-        g_slist_free_full(layouts, free_colored_layout);
 }
 
 void draw_deinit(void)
 {
+        last_frame_clear();
+        background_cache_clear();
+        layout_metrics.fdesc = NULL;
         output->win_destroy(win);
         output->deinit();
         if (settings.enable_recursive_icon_lookup)
                 free_all_themes();
 }
 
+static GPrivate pinned_scale;
+
+void draw_pin_scale(const double *scale)
+{
+        g_private_set(&pinned_scale, (gpointer)scale);
+}
+
 double draw_get_scale(void)
 {
+        const double *pinned = g_private_get(&pinned_scale);
+        if (pinned)
+                return *pinned;
+
         if (output) {
                 return output->get_scale();
         } else {
@@ -17,6 +17,13 @@ void draw_rounded_rect(cairo_t *c, float x, float y, int width, int height, int
 // TODO get rid of this function by passing scale to everything that needs it.
 double draw_get_scale(void);
 
+/**
+ * Make draw_get_scale() return *\p scale on the calling thread, without
+ * asking the output. Threads other than the main thread must not talk to
+ * the display server. Pass NULL to ask the output again.
+ */
+void draw_pin_scale(const double *scale);
+
 void draw_deinit(void);
 
 void calc_window_pos(const struct screen_info *scr, int width, int height, int *ret_x, int *ret_y);
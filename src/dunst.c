@@ -55,6 +55,78 @@ struct dunst_status dunst_status_get(void)
 /* misc functions */
 static gboolean run(void *data);
 
+/* The timer running dunst at the next change of the queues. It stays
+ * attached for the whole lifetime of the main loop, rescheduling only moves
+ * its ready time. */
+struct scheduler {
+        GSource source;
+        gint64 deadline;        /**< time_monotonic_now() to run at, or -1 */
+        unsigned int spurious;  /**< wake ups before the deadline */
+};
+
+static struct scheduler *scheduler = NULL;
+
+/**
+ * Run dunst at \p deadline or never, if it's -1. \p now is the current
+ * time_monotonic_now().
+ */
+static void scheduler_set(gint64 deadline, gint64 now)
+{
+        scheduler->deadline = deadline;
+
+        if (deadline == -1) {
+                g_source_set_ready_time(&scheduler->source, -1);
+                return;
+        }
+
+        // The main loop uses another clock, so only the duration carries over
+        gint64 sleep = MAX(deadline - now, 1000); // Sleep at least 1ms
+        LOG_D("Sleeping for %" G_GINT64_FORMAT " us", sleep);
+
+        g_source_set_ready_time(&scheduler->source, g_get_monotonic_time() + sleep);
+}
+
+static gboolean scheduler_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+        gint64 now = time_monotonic_now();
+
+        if (scheduler->deadline == -1 || now < scheduler->deadline) {
+                scheduler->spurious++;
+                LOG_D("Woke up %" G_GINT64_FORMAT " us early (%u times so far)",
+                      scheduler->deadline == -1 ? 0 : scheduler->deadline - now,
+                      scheduler->spurious);
+                scheduler_set(scheduler->deadline, now);
+                return G_SOURCE_CONTINUE;
+        }
+
+        scheduler_set(-1, now);
+        run(NULL);
+        return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs scheduler_funcs = {
+        .dispatch = scheduler_dispatch,
+};
+
+static void scheduler_setup(void)
+{
+        scheduler = (struct scheduler *)g_source_new(&scheduler_funcs, sizeof(struct scheduler));
+        scheduler->deadline = -1;
+        scheduler->spurious = 0;
+        g_source_set_name(&scheduler->source, "dunst scheduler");
+        g_source_attach(&scheduler->source, NULL);
+}
+
+static void scheduler_teardown(void)
+{
+        if (scheduler->spurious)
+                LOG_I("The scheduler woke up early %u times", scheduler->spurious);
+
+        g_source_destroy(&scheduler->source);
+        g_source_unref(&scheduler->source);
+        scheduler = NULL;
+}
+
 void wake_up(void)
 {
         // If wake_up is being called before the output has been setup we should
@@ -70,8 +142,6 @@ void wake_up(void)
 
 static gboolean run(void *data)
 {
-        static gint64 next_timeout = 0;
-        static guint next_timeout_id = 0;
         int reason = GPOINTER_TO_INT(data);
 
         LOG_D("RUN, reason %i", reason);
@@ -91,33 +161,12 @@ static gboolean run(void *data)
         draw();
         output->win_show(win);
 
-        gint64 timeout_at = queues_get_next_datachange(now);
-        if (timeout_at != -1) {
-                // Previous computations may have taken time, update `now`
-                // This might mean that `timeout_at` is now before `now`, so
-                // we have to make sure that `sleep` is still positive.
-                now = time_monotonic_now();
-                gint64 sleep = timeout_at - now;
-                sleep = MAX(sleep, 1000); // Sleep at least 1ms
-
-                LOG_D("Sleeping for %li ms", sleep/1000);
-
-                if (sleep >= 0) {
-                        if (reason == 0 || next_timeout < now || timeout_at < next_timeout) {
-                                if (next_timeout != 0) {
-                                        g_source_remove(next_timeout_id);
-                                }
-                                next_timeout_id = g_timeout_add(sleep/1000, run, NULL);
-                                next_timeout = timeout_at;
-                        }
-                }
-        }
+        // Previous computations may have taken time, update `now`. This
+        // might mean that the next change is before `now` already, which
+        // scheduler_set takes care of.
+        gint64 timeout_at = queues_get_next_datachange_coalesced(status, now);
+        scheduler_set(timeout_at, time_monotonic_now());
 
-        /* If the execution got triggered by g_timeout_add,
-         * we have to remove the timeout (which is actually a
-         * recurring interval), as we have set a new one
-         * by ourselves.
-         */
         return G_SOURCE_REMOVE;
 }
 
@@ -222,11 +271,15 @@ int dunst_main(int argc, char *argv[])
                 // we do not call wakeup now, wake_up does not work here yet
         }
 
+        scheduler_setup();
+
         setup_done = true;
         run(NULL);
         g_main_loop_run(mainloop);
         g_clear_pointer(&mainloop, g_main_loop_unref);
 
+        scheduler_teardown();
+
         /* remove signal handler watches */
         g_source_remove(pause_src);
         g_source_remove(unpause_src);
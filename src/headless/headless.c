@@ -0,0 +1,221 @@
+#include "headless.h"
+
+#include <cairo.h>
+#include <errno.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../log.h"
+#include "../settings.h"
+#include "../utils.h"
+
+#define DEFAULT_WIDTH 1920
+#define DEFAULT_HEIGHT 1080
+#define DEFAULT_DPI 96
+
+struct window_headless {
+        cairo_surface_t *surface;   /**< the frame draw() renders into */
+        bool visible;
+};
+
+struct headless_context {
+        struct screen_info screen;
+        double scale;           /**< forced scale (0: like X11) */
+
+        char *dump_dir;
+        FILE *timings;
+
+        // Only used to create the pango contexts for measuring
+        cairo_surface_t *measure_surface;
+        cairo_t *measure_ctx;
+
+        cairo_surface_t *last_frame;
+        unsigned int frame_count;
+        gint64 frame_start;
+};
+
+static struct headless_context ctx;
+
+static void headless_parse_screen(const char *geometry)
+{
+        int w, h;
+        if (sscanf(geometry, "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+                ctx.screen.w = w;
+                ctx.screen.h = h;
+        } else {
+                LOG_W("Invalid DUNST_HEADLESS_SCREEN: '%s'", geometry);
+        }
+}
+
+bool headless_init(void)
+{
+        memset(&ctx, 0, sizeof(ctx));
+
+        ctx.screen.w = DEFAULT_WIDTH;
+        ctx.screen.h = DEFAULT_HEIGHT;
+        ctx.screen.dpi = DEFAULT_DPI;
+
+        const char *env;
+        if ((env = getenv("DUNST_HEADLESS_SCREEN")))
+                headless_parse_screen(env);
+
+        if ((env = getenv("DUNST_HEADLESS_DPI"))) {
+                int dpi;
+                if (safe_string_to_int(&dpi, env) && dpi > 0)
+                        ctx.screen.dpi = dpi;
+        }
+
+        if ((env = getenv("DUNST_HEADLESS_SCALE"))) {
+                double scale;
+                if (safe_string_to_double(&scale, env) && scale > 0)
+                        ctx.scale = scale;
+        }
+
+        // Keep the physical size matching the dpi
+        ctx.screen.mmh = ctx.screen.h * 25.4 / ctx.screen.dpi;
+
+        if ((env = getenv("DUNST_HEADLESS_DUMP")) && *env)
+                ctx.dump_dir = g_strdup(env);
+
+        if ((env = getenv("DUNST_HEADLESS_TIMINGS")) && *env) {
+                ctx.timings = fopen(env, "a");
+                if (!ctx.timings)
+                        LOG_W("Cannot open timings file '%s': %s", env, strerror(errno));
+        }
+
+        ctx.measure_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+        ctx.measure_ctx = cairo_create(ctx.measure_surface);
+
+        LOG_I("Headless screen %ix%i, dpi %i, scale %.2f",
+              ctx.screen.w, ctx.screen.h, ctx.screen.dpi, headless_get_scale());
+        return true;
+}
+
+void headless_deinit(void)
+{
+        if (ctx.timings)
+                fclose(ctx.timings);
+        g_free(ctx.dump_dir);
+
+        cairo_destroy(ctx.measure_ctx);
+        cairo_surface_destroy(ctx.measure_surface);
+
+        memset(&ctx, 0, sizeof(ctx));
+}
+
+window headless_win_create(void)
+{
+        return g_malloc0(sizeof(struct window_headless));
+}
+
+void headless_win_destroy(window winptr)
+{
+        struct window_headless *win = (struct window_headless*)winptr;
+
+        if (ctx.last_frame == win->surface)
+                ctx.last_frame = NULL;
+
+        if (win->surface)
+                cairo_surface_destroy(win->surface);
+        g_free(win);
+}
+
+void headless_win_show(window winptr)
+{
+        ((struct window_headless*)winptr)->visible = true;
+}
+
+void headless_win_hide(window winptr)
+{
+        ((struct window_headless*)winptr)->visible = false;
+}
+
+void headless_display_surface(cairo_surface_t *srf, window winptr, const struct dimensions *dim)
+{
+        gint64 duration = time_monotonic_now() - ctx.frame_start;
+
+        ctx.last_frame = srf;
+        ctx.frame_count++;
+
+        if (ctx.timings) {
+                fprintf(ctx.timings, "%u %i %i %" G_GINT64_FORMAT "\n",
+                        ctx.frame_count, dim->w, dim->h, duration);
+                fflush(ctx.timings);
+        }
+
+        if (ctx.dump_dir) {
+                char *name = g_strdup_printf("frame-%05u.png", ctx.frame_count);
+                char *path = g_build_filename(ctx.dump_dir, name, NULL);
+
+                cairo_status_t status = cairo_surface_write_to_png(srf, path);
+                if (status != CAIRO_STATUS_SUCCESS)
+                        LOG_W("Cannot write frame '%s': %s", path, cairo_status_to_string(status));
+
+                g_free(name);
+                g_free(path);
+        }
+}
+
+cairo_surface_t* headless_win_get_surface(window winptr, int width, int height)
+{
+        struct window_headless *win = (struct window_headless*)winptr;
+
+        if (win->surface
+            && cairo_image_surface_get_width(win->surface) == width
+            && cairo_image_surface_get_height(win->surface) == height)
+                return win->surface;
+
+        if (ctx.last_frame == win->surface)
+                ctx.last_frame = NULL;
+
+        if (win->surface)
+                cairo_surface_destroy(win->surface);
+
+        win->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+        return win->surface;
+}
+
+cairo_t* headless_win_get_context(window winptr)
+{
+        // Every frame starts with fetching the context
+        ctx.frame_start = time_monotonic_now();
+        return ctx.measure_ctx;
+}
+
+const struct screen_info* headless_get_active_screen(void)
+{
+        return &ctx.screen;
+}
+
+bool headless_is_idle(void)
+{
+        return false;
+}
+
+bool headless_have_fullscreen_window(void)
+{
+        return false;
+}
+
+double headless_get_scale(void)
+{
+        if (ctx.scale > 0)
+                return ctx.scale;
+        if (settings.scale > 0)
+                return settings.scale;
+
+        return MAX(1, ctx.screen.dpi/96.);
+}
+
+unsigned int headless_frame_count(void)
+{
+        return ctx.frame_count;
+}
+
+cairo_surface_t *headless_last_frame(void)
+{
+        return ctx.last_frame;
+}
+/* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -0,0 +1,54 @@
+#ifndef DUNST_HEADLESS_H
+#define DUNST_HEADLESS_H
+
+#include <stdbool.h>
+#include <cairo.h>
+#include <glib.h>
+
+#include "../output.h"
+
+/*
+ * An output without any display server. Frames get rendered into memory,
+ * which makes it possible to run and benchmark dunst on machines without
+ * X11 or Wayland.
+ *
+ * It is configured via the environment:
+ *  - DUNST_HEADLESS: enables the output, when set to a non-empty value
+ *  - DUNST_HEADLESS_SCREEN: geometry of the screen as WIDTHxHEIGHT (1920x1080)
+ *  - DUNST_HEADLESS_DPI: the dpi of the screen (96)
+ *  - DUNST_HEADLESS_SCALE: the scale to render at (derived like on X11)
+ *  - DUNST_HEADLESS_DUMP: directory to save every frame to as PNG
+ *  - DUNST_HEADLESS_TIMINGS: file to append the time each frame took to
+ */
+
+bool headless_init(void);
+void headless_deinit(void);
+
+window headless_win_create(void);
+void headless_win_destroy(window);
+
+void headless_win_show(window);
+void headless_win_hide(window);
+
+void headless_display_surface(cairo_surface_t *srf, window win, const struct dimensions*);
+cairo_surface_t* headless_win_get_surface(window win, int width, int height);
+cairo_t* headless_win_get_context(window);
+
+const struct screen_info* headless_get_active_screen(void);
+
+bool headless_is_idle(void);
+bool headless_have_fullscreen_window(void);
+
+double headless_get_scale(void);
+
+/**
+ * @returns the amount of frames displayed since headless_init()
+ */
+unsigned int headless_frame_count(void);
+
+/**
+ * @returns the last frame passed to headless_display_surface() or NULL
+ */
+cairo_surface_t *headless_last_frame(void);
+#endif
+/* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -60,67 +60,116 @@ static char *markup_br2nl(char *str)
         return str;
 }
 
+/**
+ * Append the text from \p start to \p end to \p out, but leave out the
+ * closing tags in \p closing. These belong to links stripped already.
+ */
+static void markup_append_a_text(GString *out, const char *start, const char *end, GList *closing)
+{
+        for (; closing; closing = closing->next) {
+                const char *skip = closing->data;
+                if (skip < start)
+                        continue;
+                if (skip >= end)
+                        break;
+                g_string_append_len(out, start, skip - start);
+                start = skip + strlen("</a>");
+        }
+        g_string_append_len(out, start, end - start);
+}
+
 /* see markup.h */
 void markup_strip_a(char **str, char **urls)
 {
         assert(*str);
-        char *tag1 = NULL;
 
         if (urls)
                 *urls = NULL;
 
-        while ((tag1 = strstr(*str, "<a"))) {
-                // use href=" as stated in the notification spec
-                char *href = strstr(tag1, "href=\"");
-                char *tag1_end = strstr(tag1, ">");
-                char *tag2 = strstr(tag1, "</a>");
+        // Copy the string over once instead of shifting it for every tag
+        GString *out = g_string_sized_new(strlen(*str));
+        const char *pos = *str;
+
+        // The closing tags of the stripped links, in order. The text between
+        // the tags gets scanned again, as it may contain links too.
+        GQueue closing = G_QUEUE_INIT;
+
+        // The next closing tag, only looked up again once passed
+        const char *tag2 = NULL;
+        bool tag2_none = false;
+
+        const char *tag1 = strstr(pos, "<a");
+        while (tag1) {
+                const char *skip = g_queue_peek_head(&closing);
+                if (skip && skip < tag1) {
+                        // it may have been part of a stripped opening tag
+                        if (skip >= pos) {
+                                g_string_append_len(out, pos, skip - pos);
+                                pos = skip + strlen("</a>");
+                        }
+                        g_queue_pop_head(&closing);
+                        continue;
+                }
+
+                g_string_append_len(out, pos, tag1 - pos);
+
+                const char *tag1_end = strchr(tag1, '>');
+                // the links around this one took their closing tags already
+                for (GList *iter = closing.head; iter && tag1_end; iter = iter->next) {
+                        if ((const char *)iter->data + strlen("</a") == tag1_end)
+                                tag1_end = strchr(tag1_end + 1, '>');
+                }
+                if (!tag2_none && (!tag2 || tag2 < tag1))
+                        tag2 = strstr(tag1, "</a>");
+                for (GList *iter = closing.head; iter && tag2; iter = iter->next) {
+                        if (iter->data == tag2)
+                                tag2 = strstr(tag2 + strlen("</a>"), "</a>");
+                }
+                tag2_none = !tag2;
 
                 // the tag is broken, ignore it
                 if (!tag1_end) {
                         LOG_W("Given link is broken: '%s'",
                               tag1);
-                        string_replace_at(*str, tag1-*str, strlen(tag1), "");
+                        pos = tag1 + strlen(tag1);
                         break;
                 }
                 if (tag2 && tag2 < tag1_end) {
                         int repl_len =  (tag2 - tag1) + strlen("</a>");
                         LOG_W("Given link is broken: '%.*s.'",
                               repl_len, tag1);
-                        string_replace_at(*str, tag1-*str, repl_len, "");
+                        pos = tag1 + repl_len;
                         break;
                 }
 
                 // search contents of href attribute
+                // use href=" as stated in the notification spec
                 char *plain_url = NULL;
-                if (href && href < tag1_end) {
+                GString *tag = g_string_new(NULL);
+                markup_append_a_text(tag, tag1, tag1_end, closing.head);
+                const char *href = strstr(tag->str, "href=\"");
+                if (href) {
 
                         // shift href to the actual begin of the value
                         href = href+6;
 
-                        const char *quote = strstr(href, "\"");
+                        const char *quote = strchr(href, '"');
 
-                        if (quote && quote < tag1_end) {
+                        if (quote) {
                                 plain_url = g_strndup(href, quote-href);
                         }
                 }
-
-                // text between a tags
-                int text_len;
-                if (tag2)
-                        text_len = tag2 - (tag1_end+1);
-                else
-                        text_len = strlen(tag1_end+1);
-
-                char *text = g_strndup(tag1_end+1, text_len);
-
-                int repl_len = text_len + (tag1_end-tag1) + 1;
-                repl_len += tag2 ? strlen("</a>") : 0;
-
-                *str = string_replace_at(*str, tag1-*str, repl_len, text);
+                g_string_free(tag, true);
 
                 // if there had been a href attribute,
                 // add it to the URLs
                 if (plain_url && urls) {
+                        // text between a tags
+                        const char *text_end = tag2 ? tag2 : tag1_end + strlen(tag1_end);
+                        GString *text_str = g_string_new(NULL);
+                        markup_append_a_text(text_str, tag1_end+1, text_end, closing.head);
+
+                        char *text = g_string_free(text_str, false);
                         text = string_replace_all("]", "", text);
                         text = string_replace_all("[", "", text);
 
@@ -128,11 +177,23 @@ void markup_strip_a(char **str, char **urls)
 
                         *urls = string_append(*urls, url, "\n");
                         g_free(url);
+                        g_free(text);
                 }
 
                 g_free(plain_url);
-                g_free(text);
+
+                if (tag2)
+                        g_queue_push_tail(&closing, (gpointer)tag2);
+
+                pos = tag1_end + 1;
+                tag1 = strstr(pos, "<a");
         }
+
+        markup_append_a_text(out, pos, pos + strlen(pos), closing.head);
+        g_queue_clear(&closing);
+
+        g_free(*str);
+        *str = g_string_free(out, false);
 }
 
 /* see markup.h */
@@ -143,28 +204,35 @@ void markup_strip_img(char **str, char **urls)
         if (urls)
                 *urls = NULL;
 
-        while ((start = strstr(*str, "<img"))) {
-                const char *end = strstr(start, ">");
+        // Copy the string over once instead of shifting it for every tag
+        GString *out = g_string_sized_new(strlen(*str));
+        const char *pos = *str;
+
+        while ((start = strstr(pos, "<img"))) {
+                g_string_append_len(out, pos, start - pos);
+
+                const char *end = strchr(start, '>');
 
                 // the tag is broken, ignore it
                 if (!end) {
                         LOG_W("Given image is broken: '%s'", start);
-                        string_replace_at(*str, start-*str, strlen(start), "");
+                        pos = start + strlen(start);
                         break;
                 }
 
                 // use attribute=" as stated in the notification spec
-                const char *alt_s = strstr(start, "alt=\"");
-                const char *src_s = strstr(start, "src=\"");
+                // Attributes past the end of the tag don't count anyway
+                const char *alt_s = g_strstr_len(start, end - start, "alt=\"");
+                const char *src_s = g_strstr_len(start, end - start, "src=\"");
 
                 char *text_alt = NULL;
                 char *text_src = NULL;
 
                 const char *src_e = NULL, *alt_e = NULL;
                 if (alt_s)
-                        alt_e = strstr(alt_s + strlen("alt=\""), "\"");
+                        alt_e = memchr(alt_s + strlen("alt=\""), '"', end - (alt_s + strlen("alt=\"")));
                 if (src_s)
-                        src_e = strstr(src_s + strlen("src=\""), "\"");
+                        src_e = memchr(src_s + strlen("src=\""), '"', end - (src_s + strlen("src=\"")));
 
                 // Move pointer to the actual start
                 alt_s = alt_s ? alt_s + strlen("alt=\"") : NULL;
@@ -194,12 +262,11 @@ void markup_strip_img(char **str, char **urls)
                 }
 
                 // replacement text for alt
-                int repl_len = end - start + 1;
-
                 if (!text_alt)
                         text_alt = g_strdup("[image]");
 
-                *str = string_replace_at(*str, start-*str, repl_len, text_alt);
+                g_string_append(out, text_alt);
+                pos = end + 1;
 
                 // if there had been a href attribute,
                 // add it to the URLs
@@ -216,6 +283,10 @@ void markup_strip_img(char **str, char **urls)
                 g_free(text_src);
                 g_free(text_alt);
         }
+
+        g_string_append(out, pos);
+        g_free(*str);
+        *str = g_string_free(out, false);
 }
 
 /* see markup.h */
@@ -282,8 +353,8 @@ static bool markup_is_entity(const char *str)
 }
 
 /**
- * Escape all unsupported and invalid &-entities in a string. If the resulting
- * string does not fit it will be reallocated.
+ * Escape all unsupported and invalid &-entities in a string. The string gets
+ * reallocated, if there is anything to escape.
  *
  * @param str The string to be transformed
  */
@@ -291,18 +362,24 @@ static char *markup_escape_unsupported(char *str)
 {
         ASSERT_OR_RET(str, NULL);
 
-        char *match = str;
-        while ((match = strchr(match, '&'))) {
+        char *match = strchr(str, '&');
+        if (!match)
+                return str;
+
+        GString *result = g_string_sized_new(strlen(str));
+        const char *cur = str;
+
+        for (; match; match = strchr(match + 1, '&')) {
                 if (!markup_is_entity(match)) {
-                        int pos = match - str;
-                        str = string_replace_at(str, pos, 1, "&amp;");
-                        match = str + pos + strlen("&amp;");
-                } else {
-                        match++;
+                        g_string_append_len(result, cur, match - cur);
+                        g_string_append(result, "&amp;");
+                        cur = match + 1;
                 }
         }
+        g_string_append(result, cur);
 
-        return str;
+        g_free(str);
+        return g_string_free(result, FALSE);
 }
 
 /* see markup.h */
@@ -338,4 +415,22 @@ char *markup_transform(char *str, enum markup_mode markup_mode)
         return str;
 }
 
+/* see markup.h */
+char *markup_transform_plain(char *str, enum markup_mode markup_mode)
+{
+        ASSERT_OR_RET(str, NULL);
+        assert(markup_mode == MARKUP_NO || markup_mode == MARKUP_STRIP);
+
+        if (markup_mode == MARKUP_STRIP) {
+                str = markup_br2nl(str);
+                str = markup_strip(str);
+        }
+
+        if (settings.ignore_newline) {
+                str = string_replace_all("\n", " ", str);
+        }
+
+        return str;
+}
+
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
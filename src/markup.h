@@ -47,5 +47,11 @@ void markup_strip_img(char **str, char **urls);
  */
 char *markup_transform(char *str, enum markup_mode markup_mode);
 
+/**
+ * Transform the string like `markup_transform()`, but return the plain text
+ * the quoted result stands for. Only for MARKUP_NO and MARKUP_STRIP.
+ */
+char *markup_transform_plain(char *str, enum markup_mode markup_mode);
+
 #endif
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
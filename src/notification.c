@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <glib.h>
 #include <libgen.h>
+#include <pango/pango.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -283,6 +284,11 @@ void notification_unref(struct notification *n)
         g_free(n->category);
         g_free(n->text_to_render);
         g_free(n->urls);
+        g_free(n->markup_source);
+        g_free(n->markup_text);
+        pango_attr_list_unref(n->markup_attrs);
+        g_free(n->msg_text);
+        pango_attr_list_unref(n->msg_attrs);
         g_free(n->colors.fg);
         g_free(n->colors.bg);
         g_free(n->colors.highlight);
@@ -311,6 +317,8 @@ void notification_transfer_icon(struct notification *from, struct notification *
         if (from->iconname && to->iconname
                         && strcmp(from->iconname, to->iconname) == 0){
                 // Icons are the same. Transfer icon surface
+                if (to->icon)
+                        cairo_surface_destroy(to->icon);
                 to->icon = from->icon;
 
                 // prevent the surface being freed by the old notification
@@ -318,6 +326,17 @@ void notification_transfer_icon(struct notification *from, struct notification *
         }
 }
 
+void notification_transfer_markup(struct notification *from, struct notification *to)
+{
+        if (!STR_EQ(from->msg, to->msg) || to->markup_source)
+                return;
+
+        to->markup_failed = from->markup_failed;
+        to->markup_source = g_steal_pointer(&from->markup_source);
+        to->markup_text = g_steal_pointer(&from->markup_text);
+        to->markup_attrs = g_steal_pointer(&from->markup_attrs);
+}
+
 void notification_icon_replace_path(struct notification *n, const char *new_icon)
 {
         ASSERT_OR_RET(n,);
@@ -367,30 +386,6 @@ void notification_icon_replace_data(struct notification *n, GVariant *new_icon)
                 g_object_unref(icon);
 }
 
-/* see notification.h */
-void notification_replace_single_field(char **haystack,
-                                       char **needle,
-                                       const char *replacement,
-                                       enum markup_mode markup_mode)
-{
-
-        assert(*needle[0] == '%');
-        // needle has to point into haystack (but not on the last char)
-        assert(*needle >= *haystack);
-        assert(*needle - *haystack < strlen(*haystack) - 1);
-
-        int pos = *needle - *haystack;
-
-        char *input = markup_transform(g_strdup(replacement), markup_mode);
-        *haystack = string_replace_at(*haystack, pos, 2, input);
-
-        // point the needle to the next char
-        // which was originally in haystack
-        *needle = *haystack + pos + strlen(input);
-
-        g_free(input);
-}
-
 static NotificationPrivate *notification_private_create(void)
 {
         NotificationPrivate *priv = g_malloc0(sizeof(NotificationPrivate));
@@ -407,7 +402,6 @@ struct notification *notification_create(void)
         n->priv = notification_private_create();
 
         /* Unparameterized default values */
-        n->first_render = true;
         n->markup = MARKUP_FULL;
         n->format = settings.format;
 
@@ -517,106 +511,217 @@ void notification_init(struct notification *n)
 
 }
 
+/* Marks the fields in the format, when it gets parsed as markup on its own.
+ * U+FFFC OBJECT REPLACEMENT CHARACTER */
+#define FIELD_MARK "\xEF\xBF\xBC"
+
+struct format_builder {
+        GString *msg;           /**< the message as markup */
+        GString *marked;        /**< the format with the fields marked or NULL */
+        GPtrArray *fields;      /**< the plain text of the marked fields */
+};
+
+struct field_shift {
+        guint end;              /**< the end of the mark in the parsed format */
+        gssize delta;           /**< how far the text after it moves */
+};
+
+/**
+ * Append \p len bytes of the format at \p str to the message.
+ */
+static void format_append_len(struct format_builder *b, const char *str, gssize len)
+{
+        g_string_append_len(b->msg, str, len);
+        if (b->marked)
+                g_string_append_len(b->marked, str, len);
+}
+
+/**
+ * Append \p value to the message, quoted according to \p markup_mode.
+ */
+static void format_append_field(struct format_builder *b, const char *value, enum markup_mode markup_mode)
+{
+        char *input = markup_transform(g_strdup(value), markup_mode);
+        g_string_append(b->msg, input);
+        g_free(input);
+
+        if (b->marked) {
+                g_string_append(b->marked, FIELD_MARK);
+                g_ptr_array_add(b->fields, markup_transform_plain(g_strdup(value), markup_mode));
+        }
+}
+
+static guint field_shift_index(GArray *shifts, guint index)
+{
+        if (index == G_MAXUINT)
+                return index;
+
+        gssize delta = 0;
+        for (guint i = 0; i < shifts->len; i++) {
+                struct field_shift *shift = &g_array_index(shifts, struct field_shift, i);
+                if (shift->end > index)
+                        break;
+                delta = shift->delta;
+        }
+        return index + delta;
+}
+
+static gboolean field_shift_attr(PangoAttribute *attr, gpointer data)
+{
+        attr->start_index = field_shift_index(data, attr->start_index);
+        attr->end_index = field_shift_index(data, attr->end_index);
+        return false;
+}
+
+/**
+ * Build the text and attributes of the message directly from the plain
+ * fields. Only the short format gets parsed as markup, instead of the quoted
+ * fields with it. Leaves msg_text unset, if the message has to be parsed.
+ *
+ * @param chomped the number of bytes cut off the end of the message
+ */
+static void notification_build_msg_text(struct notification *n, struct format_builder *b, gsize chomped)
+{
+        char *format;
+        PangoAttrList *attrs;
+        if (!pango_parse_markup(b->marked->str, -1, 0, &attrs, &format, NULL, NULL))
+                return;
+
+        GString *text = g_string_sized_new(strlen(format));
+        GArray *shifts = g_array_new(false, false, sizeof(struct field_shift));
+        const char *cur = format;
+        const char *mark;
+        gssize delta = 0;
+
+        while ((mark = strstr(cur, FIELD_MARK)) && shifts->len < b->fields->len) {
+                const char *field = g_ptr_array_index(b->fields, shifts->len);
+                g_string_append_len(text, cur, mark - cur);
+                g_string_append(text, field);
+
+                delta += (gssize)strlen(field) - (gssize)strlen(FIELD_MARK);
+                cur = mark + strlen(FIELD_MARK);
+                struct field_shift shift = { cur - format, delta };
+                g_array_append_val(shifts, shift);
+        }
+        g_string_append(text, cur);
+
+        // The format contained the mark itself or the fields aren't valid text
+        bool valid = !mark && shifts->len == b->fields->len
+                     && g_utf8_validate(text->str, text->len, NULL)
+                     && chomped <= text->len;
+        for (gsize i = 1; valid && i <= chomped; i++)
+                valid = g_ascii_isspace(text->str[text->len - i]);
+
+        if (valid) {
+                g_string_truncate(text, text->len - chomped);
+                pango_attr_list_filter(attrs, field_shift_attr, shifts);
+                n->msg_text = g_string_free(text, false);
+                n->msg_attrs = attrs;
+        } else {
+                g_string_free(text, true);
+                pango_attr_list_unref(attrs);
+        }
+
+        g_array_free(shifts, true);
+        g_free(format);
+}
+
 static void notification_format_message(struct notification *n)
 {
         g_clear_pointer(&n->msg, g_free);
+        g_clear_pointer(&n->msg_text, g_free);
+        g_clear_pointer(&n->msg_attrs, pango_attr_list_unref);
 
-        n->msg = string_replace_all("\\n", "\n", g_strdup(n->format));
+        char *format = string_replace_all("\\n", "\n", g_strdup(n->format));
 
-        /* replace all formatter */
-        for(char *substr = strchr(n->msg, '%');
-                  substr && *substr;
-                  substr = strchr(substr, '%')) {
+        /* Expand the format in a single pass. Replacing the fields one
+         * after the other moves the remainder of the string every time,
+         * which gets expensive with large bodies. */
+        struct format_builder b = { g_string_sized_new(strlen(format)), NULL, NULL };
+
+        /* Without markup in the body, the fields are plain text and the
+         * message can be built without parsing them again */
+        if (n->markup == MARKUP_NO || n->markup == MARKUP_STRIP) {
+                b.marked = g_string_sized_new(strlen(format));
+                b.fields = g_ptr_array_new_with_free_func(g_free);
+        }
+
+        const char *cur = format;
+        const char *substr;
+
+        while ((substr = strchr(cur, '%'))) {
+                format_append_len(&b, cur, substr - cur);
 
                 char pg[16];
                 char *icon_tmp;
 
                 switch(substr[1]) {
                 case 'a':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->appname,
-                                MARKUP_NO);
+                        format_append_field(&b, n->appname, MARKUP_NO);
                         break;
                 case 's':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->summary,
-                                MARKUP_NO);
+                        format_append_field(&b, n->summary, MARKUP_NO);
                         break;
                 case 'b':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->body,
-                                n->markup);
+                        format_append_field(&b, n->body, n->markup);
                         break;
                 case 'I':
                         icon_tmp = g_strdup(n->iconname);
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                icon_tmp ? basename(icon_tmp) : "",
-                                MARKUP_NO);
+                        format_append_field(&b, icon_tmp ? basename(icon_tmp) : "", MARKUP_NO);
                         g_free(icon_tmp);
                         break;
                 case 'i':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->iconname ? n->iconname : "",
-                                MARKUP_NO);
+                        format_append_field(&b, n->iconname ? n->iconname : "", MARKUP_NO);
                         break;
                 case 'p':
                         if (n->progress != -1)
                                 sprintf(pg, "[%3d%%]", n->progress);
 
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->progress != -1 ? pg : "",
-                                MARKUP_NO);
+                        format_append_field(&b, n->progress != -1 ? pg : "", MARKUP_NO);
                         break;
                 case 'n':
                         if (n->progress != -1)
                                 sprintf(pg, "%d", n->progress);
 
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->progress != -1 ? pg : "",
-                                MARKUP_NO);
+                        format_append_field(&b, n->progress != -1 ? pg : "", MARKUP_NO);
                         break;
                 case '%':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                "%",
-                                MARKUP_NO);
+                        format_append_len(&b, "%", 1);
                         break;
                 case '\0':
                         LOG_W("format_string has trailing %% character. "
                               "To escape it use %%%%.");
-                        substr++;
-                        break;
+                        format_append_len(&b, "%", 1);
+                        cur = substr + 1;
+                        continue;
                 default:
                         LOG_W("format_string %%%c is unknown.", substr[1]);
-                        // shift substr pointer forward,
-                        // as we can't interpret the format string
-                        substr++;
-                        break;
+                        // keep the % as is, as we can't interpret the format string
+                        format_append_len(&b, "%", 1);
+                        cur = substr + 1;
+                        continue;
                 }
+
+                cur = substr + 2;
         }
+        format_append_len(&b, cur, -1);
+        g_free(format);
 
-        n->msg = g_strchomp(n->msg);
+        gsize len = b.msg->len;
+        n->msg = g_strchomp(g_string_free(b.msg, FALSE));
 
         /* truncate overlong messages */
         if (strnlen(n->msg, DUNST_NOTIF_MAX_CHARS + 1) > DUNST_NOTIF_MAX_CHARS) {
                 char * buffer = g_strndup(n->msg, DUNST_NOTIF_MAX_CHARS);
                 g_free(n->msg);
                 n->msg = buffer;
+        } else if (b.marked) {
+                notification_build_msg_text(n, &b, len - strlen(n->msg));
+        }
+
+        if (b.marked) {
+                g_string_free(b.marked, true);
+                g_ptr_array_unref(b.fields);
         }
 }
 
@@ -669,6 +774,7 @@ void notification_update_text_to_render(struct notification *n)
         } else {
                 buf = g_strdup(msg);
         }
+        n->msg_start = strlen(buf) - strlen(msg);
 
         /* print age */
         gint64 hours, minutes, seconds;
@@ -701,6 +807,69 @@ void notification_update_text_to_render(struct notification *n)
         n->text_to_render = buf;
 }
 
+/**
+ * Fill the markup cache with the text and attributes built along with the
+ * message. The indicators and the age around the message are plain text, so
+ * they only get copied.
+ *
+ * @returns false, if text_to_render has to be parsed instead
+ */
+static bool notification_markup_from_msg(struct notification *n)
+{
+        const char *ttr = n->text_to_render;
+        if (!n->msg_text || !n->msg || n->msg_start > strlen(ttr))
+                return false;
+
+        size_t msg_len = strlen(n->msg);
+        if (strncmp(ttr + n->msg_start, n->msg, msg_len) != 0)
+                return false;
+
+        const char *suffix = ttr + n->msg_start + msg_len;
+        if (strcspn(ttr, "<&") < n->msg_start || strpbrk(suffix, "<&"))
+                return false;
+
+        GString *text = g_string_new_len(ttr, n->msg_start);
+        g_string_append(text, n->msg_text);
+        g_string_append(text, suffix);
+
+        n->markup_attrs = pango_attr_list_new();
+        pango_attr_list_splice(n->markup_attrs, n->msg_attrs, n->msg_start, strlen(n->msg_text));
+        n->markup_text = g_string_free(text, false);
+        return true;
+}
+
+/* see notification.h */
+void notification_get_markup(struct notification *n, const char **text, PangoAttrList **attrs)
+{
+        if (!STR_EQ(n->markup_source, n->text_to_render)) {
+                g_free(n->markup_source);
+                g_free(n->markup_text);
+                pango_attr_list_unref(n->markup_attrs);
+                n->markup_text = NULL;
+                n->markup_attrs = NULL;
+
+                n->markup_source = g_strdup(n->text_to_render);
+
+                GError *err = NULL;
+                if (!n->markup_failed
+                    && !notification_markup_from_msg(n)
+                    && !pango_parse_markup(n->text_to_render, -1, 0,
+                                           &n->markup_attrs, &n->markup_text,
+                                           NULL, &err)) {
+                        LOG_W("Unable to parse markup: %s", err->message);
+                        g_error_free(err);
+                        n->markup_failed = true;
+                }
+
+                /* remove markup and display plain message instead */
+                if (n->markup_failed)
+                        n->markup_text = markup_strip(g_strdup(n->text_to_render));
+        }
+
+        *text = n->markup_text;
+        *attrs = n->markup_attrs;
+}
+
 /* see notification.h */
 void notification_do_action(struct notification *n)
 {
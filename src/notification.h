@@ -68,6 +68,7 @@ struct notification {
         int max_icon_size; /**< Maximum icon size. */
         enum icon_position icon_position;       /**< Icon position (enum left,right,top,off). */
         bool receiving_raw_icon; /**< Still waiting for raw icon to be received */
+        bool icon_searched; /**< The icon got looked up already, even if none was found */
 
         gint64 start;      /**< begin of current display (in milliseconds) */
         gint64 timestamp;  /**< arrival time (in milliseconds) */
@@ -95,7 +96,6 @@ struct notification {
 
         /* internal */
         bool redisplayed;       /**< has been displayed before? */
-        bool first_render;      /**< markup has been rendered before? */
         int dup_count;          /**< amount of duplicate notifications stacked onto this */
         int displayed_height;
         enum behavior_fullscreen fullscreen; //!< The instruction what to do with it, when desktop enters fullscreen
@@ -110,6 +110,17 @@ struct notification {
         char *msg;            /**< formatted message */
         char *text_to_render; /**< formatted message (with age and action indicators) */
         char *urls;           /**< urllist delimited by '\\n' */
+
+        /* msg built without markup, see notification_format_message() */
+        char *msg_text;               /**< msg without markup or NULL, if it has to be parsed */
+        PangoAttrList *msg_attrs;     /**< the attributes of #msg_text */
+        gsize msg_start;              /**< where msg starts in text_to_render */
+
+        /* text_to_render parsed as markup, see notification_get_markup() */
+        char *markup_source;          /**< the text_to_render the cache belongs to */
+        char *markup_text;            /**< the text without markup */
+        PangoAttrList *markup_attrs;  /**< the attributes of the markup */
+        bool markup_failed;           /**< msg is no valid markup, so don't bother parsing it */
 };
 
 /**
@@ -178,6 +189,13 @@ struct notification *notification_unlock(struct notification *n);
  */
 void notification_transfer_icon(struct notification *from, struct notification *to);
 
+/**
+ * Transfer the parsed markup of \p from to \p to, when both have the same
+ * message. This way stacked notifications don't have to parse their text
+ * again.
+ */
+void notification_transfer_markup(struct notification *from, struct notification *to);
+
 /**Replace the current notification's icon with the icon specified by path.
  *
  * Removes the reference for the previous icon automatically and will also free the
@@ -211,19 +229,21 @@ void notification_run_script(struct notification *n);
  */
 void notification_print(const struct notification *n);
 
+void notification_update_text_to_render(struct notification *n);
+
 /**
- * Replace the two chars where **needle points
- * with a quoted "replacement", according to the markup settings.
+ * Get the text_to_render of the notification parsed as pango markup.
+ *
+ * The result is cached on the notification until text_to_render changes.
+ * When the markup is invalid, the text is stripped of all markup instead and
+ * the message won't be parsed as markup anymore.
  *
- * The needle is a double pointer and gets updated upon return
- * to point to the first char, which occurs after replacement.
+ * @param n the notification
+ * @param text Set to the text without markup. Owned by the notification.
+ * @param attrs Set to the attributes of the markup or NULL. Owned by the
+ *              notification, so take a reference to keep it around.
  */
-void notification_replace_single_field(char **haystack,
-                                       char **needle,
-                                       const char *replacement,
-                                       enum markup_mode markup_mode);
-
-void notification_update_text_to_render(struct notification *n);
+void notification_get_markup(struct notification *n, const char **text, PangoAttrList **attrs);
 
 /**
  * If the notification has an action named n->default_action_name or there is only one
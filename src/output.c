@@ -1,6 +1,7 @@
 #include "output.h"
 
 #include "log.h"
+#include "headless/headless.h"
 #include "x11/x.h"
 #include "x11/screen.h"
 
@@ -13,6 +14,11 @@ bool is_running_wayland(void) {
         return !(wayland_display == NULL);
 }
 
+bool is_running_headless(void) {
+        char* headless = getenv("DUNST_HEADLESS");
+        return headless && *headless;
+}
+
 const struct output output_x11 = {
         x_setup,
         x_free,
@@ -24,6 +30,7 @@ const struct output output_x11 = {
         x_win_hide,
 
         x_display_surface,
+        x_win_get_surface,
         x_win_get_context,
 
         get_active_screen,
@@ -34,6 +41,28 @@ const struct output output_x11 = {
         x_get_scale,
 };
 
+const struct output output_headless = {
+        headless_init,
+        headless_deinit,
+
+        headless_win_create,
+        headless_win_destroy,
+
+        headless_win_show,
+        headless_win_hide,
+
+        headless_display_surface,
+        headless_win_get_surface,
+        headless_win_get_context,
+
+        headless_get_active_screen,
+
+        headless_is_idle,
+        headless_have_fullscreen_window,
+
+        headless_get_scale,
+};
+
 #ifdef ENABLE_WAYLAND
 const struct output output_wl = {
         wl_init,
@@ -46,6 +75,7 @@ const struct output output_wl = {
         wl_win_hide,
 
         wl_display_surface,
+        wl_win_get_surface,
         wl_win_get_context,
 
         wl_get_active_screen,
@@ -66,6 +96,12 @@ const struct output* get_x11_output() {
         }
 }
 
+const struct output* get_headless_output() {
+        const struct output* output = &output_headless;
+        output->init();
+        return output;
+}
+
 #ifdef ENABLE_WAYLAND
 const struct output* get_wl_output() {
         const struct output* output = &output_wl;
@@ -81,6 +117,11 @@ const struct output* get_wl_output() {
 
 const struct output* output_create(bool force_xwayland)
 {
+        if (is_running_headless()) {
+                LOG_I("Using headless output");
+                return get_headless_output();
+        }
+
 #ifdef ENABLE_WAYLAND
         if (!force_xwayland && is_running_wayland()) {
                 LOG_I("Using Wayland output");
@@ -40,6 +40,13 @@ struct output {
 
         void (*display_surface)(cairo_surface_t *srf, window win, const struct dimensions*);
 
+        /**
+         * Acquire the surface of \p width x \p height pixels the next frame
+         * should be drawn into. The surface is owned by the output and may
+         * still contain the contents of a previous frame.
+         */
+        cairo_surface_t* (*win_get_surface)(window, int width, int height);
+
         cairo_t* (*win_get_context)(window);
 
         const struct screen_info* (*get_active_screen)(void);
@@ -54,10 +61,13 @@ struct output {
  * return an initialized output, selecting the correct output type from either
  * wayland or X11 according to the settings and environment.
  * When the wayland output fails to initilize, it falls back to X11 output.
+ * When DUNST_HEADLESS is set, the headless output is used instead.
  */
 const struct output* output_create(bool force_xwayland);
 
 bool is_running_wayland(void);
 
+bool is_running_headless(void);
+
 #endif
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -196,7 +196,7 @@ int queues_notification_insert(struct notification *n)
         if (!inserted)
                 g_queue_insert_sorted(waiting, n, notification_cmp_data, NULL);
 
-        if (!n->icon) {
+        if (!n->icon && !n->icon_searched) {
                 notification_icon_replace_path(n, n->iconname);
         }
 
@@ -237,6 +237,7 @@ static bool queues_stack_duplicate(struct notification *new)
                                         new->start = time_monotonic_now();
 
                                 notification_transfer_icon(old, new);
+                                notification_transfer_markup(old, new);
 
                                 notification_unref(old);
                                 return true;
@@ -273,6 +274,7 @@ static bool queues_stack_by_tag(struct notification *new)
                                 }
 
                                 notification_transfer_icon(old, new);
+                                notification_transfer_markup(old, new);
 
                                 notification_unref(old);
                                 return true;
@@ -300,6 +302,11 @@ bool queues_notification_replace_id(struct notification *new)
                                         notification_run_script(new);
                                 }
 
+                                // Updates usually keep their icon, don't load it again
+                                if (!new->icon)
+                                        notification_transfer_icon(old, new);
+                                notification_transfer_markup(old, new);
+
                                 notification_unref(old);
                                 return true;
                         }
@@ -550,8 +557,14 @@ void queues_update(struct dunst_status status, gint64 time)
         signal_length_propertieschanged();
 }
 
-/* see queues.h */
-gint64 queues_get_next_datachange(gint64 time)
+/**
+ * Calculate the next change of the queues
+ *
+ * @param time the current time
+ * @param idle the user is idle, so the notifications don't time out
+ * @param slack delay the changes to the next multiple of it (0: exactly)
+ */
+static gint64 queues_next_datachange(gint64 time, bool idle, gint64 slack)
 {
         gint64 wakeup_time = G_MAXINT64;
         gint64 next_second = time + S2US(1) - (time % S2US(1));
@@ -562,14 +575,19 @@ gint64 queues_get_next_datachange(gint64 time)
                 gint64 timeout_ts = n->timestamp + n->timeout;
 
                 if (n->timeout > 0 && n->locked == 0) {
-                        if (timeout_ts > time)
+                        if (idle && !n->transient)
+                                // It doesn't time out while the user is idle,
+                                // only check once in a while if that's over
+                                wakeup_time = MIN(wakeup_time, time + slack);
+                        else if (timeout_ts > time)
                                 wakeup_time = MIN(wakeup_time, timeout_ts);
                         else
                                 // while we're processing or while locked, the notification already timed out
                                 return time;
                 }
 
-                if (settings.show_age_threshold >= 0) {
+                // Nobody watches the age going up while being idle
+                if (settings.show_age_threshold >= 0 && !idle) {
                         gint64 age = time - n->timestamp;
 
                         if (age > settings.show_age_threshold - S2US(1)) {
@@ -586,7 +604,30 @@ gint64 queues_get_next_datachange(gint64 time)
                 }
         }
 
-        return wakeup_time != G_MAXINT64 ? wakeup_time : -1;
+        if (wakeup_time == G_MAXINT64)
+                return -1;
+
+        // All changes within the same window share a single wake up
+        if (slack > 0 && wakeup_time % slack != 0)
+                wakeup_time += slack - wakeup_time % slack;
+
+        return wakeup_time;
+}
+
+/* see queues.h */
+gint64 queues_get_next_datachange(gint64 time)
+{
+        return queues_next_datachange(time, false, 0);
+}
+
+/* see queues.h */
+gint64 queues_get_next_datachange_coalesced(struct dunst_status status, gint64 time)
+{
+        if (settings.timer_slack <= 0)
+                return queues_get_next_datachange(time);
+
+        bool is_idle = status.fullscreen ? false : status.idle;
+        return queues_next_datachange(time, is_idle, settings.timer_slack);
 }
 
 
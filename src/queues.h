@@ -169,6 +169,17 @@ void queues_update(struct dunst_status status, gint64 time);
  */
 gint64 queues_get_next_datachange(gint64 time);
 
+/**
+ * Like queues_get_next_datachange(), but coalesces the events according to
+ * settings.timer_slack to wake up less often. The events get delayed to the
+ * next multiple of the slack and the age isn't updated while the user is
+ * idle.
+ *
+ * @param status the current status of dunst
+ * @param time the current time
+ */
+gint64 queues_get_next_datachange_coalesced(struct dunst_status status, gint64 time);
+
 /**
  * Get the notification which has the given id in the displayed and waiting queue or
  * NULL if not found
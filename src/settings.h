@@ -105,6 +105,7 @@ struct settings {
         int indicate_hidden;
         gint64 idle_threshold;
         gint64 show_age_threshold;
+        gint64 timer_slack;
         enum alignment align;
         int sticky_history;
         int history_length;
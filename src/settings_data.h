@@ -924,6 +924,16 @@ static const struct setting allowed_settings[] = {
                 .parser = NULL,
                 .parser_data = NULL,
         },
+        {
+                .name = "timer_slack",
+                .section = "global",
+                .description = "Delay updates of the notifications by up to this time to save power",
+                .type = TYPE_TIME,
+                .default_value = "0",
+                .value = &settings.timer_slack,
+                .parser = NULL,
+                .parser_data = NULL,
+        },
         {
                 .name = "hide_duplicate_count",
                 .section = "global",
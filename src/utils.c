@@ -65,24 +65,50 @@ char *string_replace_all(const char *needle, const char *replacement, char *hays
         assert(needle);
         assert(replacement);
 
-        char *start;
-        int needle_pos;
-        int needle_len, repl_len;
-
-        needle_len = strlen(needle);
+        size_t needle_len = strlen(needle);
         if (needle_len == 0) {
                 return haystack;
         }
 
-        start = strstr(haystack, needle);
-        repl_len = strlen(replacement);
+        const char *start = strstr(haystack, needle);
+        if (!start) {
+                return haystack;
+        }
+
+        size_t repl_len = strlen(replacement);
+        const char *cur = haystack;
+
+        // The result fits, so shift everything into place in a single pass
+        if (repl_len <= needle_len) {
+                char *out = haystack;
+
+                while (start) {
+                        memmove(out, cur, start - cur);
+                        out += start - cur;
+                        memcpy(out, replacement, repl_len);
+                        out += repl_len;
+                        cur = start + needle_len;
+                        start = strstr(cur, needle);
+                }
+                memmove(out, cur, strlen(cur) + 1);
+
+                return haystack;
+        }
+
+        // Copy the string over in a single pass, instead of moving the
+        // remainder of the string for every single occurence
+        GString *result = g_string_sized_new(strlen(haystack));
 
         while (start) {
-                needle_pos = start - haystack;
-                haystack = string_replace_at(haystack, needle_pos, needle_len, replacement);
-                start = strstr(haystack + needle_pos + repl_len, needle);
+                g_string_append_len(result, cur, start - cur);
+                g_string_append_len(result, replacement, repl_len);
+                cur = start + needle_len;
+                start = strstr(cur, needle);
         }
-        return haystack;
+        g_string_append(result, cur);
+
+        g_free(haystack);
+        return g_string_free(result, FALSE);
 }
 
 /* see utils.h */
@@ -53,6 +53,8 @@ char *string_replace_at(char *buf, int pos, int len, const char *repl);
 /**
  * Replace all occurences of a substring.
  *
+ * May reallocate memory. Free the result with `g_free`.
+ *
  * @param needle The substring to search
  * @param replacement The substring to replace
  * @param haystack (nullable) The string to search the substring for
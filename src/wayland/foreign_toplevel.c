@@ -11,6 +11,7 @@
 #include "wl.h"
 
 struct wl_list toplevel_list;
+unsigned int toplevel_fullscreen_count = 0;
 
 static void noop() {
         // This space intentionally left blank
@@ -27,6 +28,23 @@ static void copy_state(struct toplevel_state *current,
 
 static uint32_t global_id = 0;
 
+/*
+ * Add (delta = 1) or remove (delta = -1) the toplevel from the counters of
+ * activated fullscreen toplevels. These make wl_have_fullscreen_window()
+ * independent of the number of toplevels.
+ */
+static void toplevel_count(struct toplevel_v1 *toplevel, int delta) {
+        if (!toplevel->counted)
+                return;
+
+        struct toplevel_output *pos;
+        wl_list_for_each(pos, &toplevel->output_list, link) {
+                pos->dunst_output->fullscreen_count += delta;
+        }
+        if (!wl_list_empty(&toplevel->output_list))
+                toplevel_fullscreen_count += delta;
+}
+
 static void toplevel_handle_output_enter(void *data,
                 struct zwlr_foreign_toplevel_handle_v1 *zwlr_toplevel,
                 struct wl_output *wl_output) {
@@ -35,7 +53,9 @@ static void toplevel_handle_output_enter(void *data,
         struct dunst_output *dunst_output = wl_output_get_user_data(wl_output);
         toplevel_output->dunst_output = dunst_output;
 
+        toplevel_count(toplevel, -1);
         wl_list_insert(&toplevel->output_list, &toplevel_output->link);
+        toplevel_count(toplevel, 1);
 }
 
 static void toplevel_handle_output_leave(void *data,
@@ -45,10 +65,31 @@ static void toplevel_handle_output_leave(void *data,
 
         struct dunst_output *output = wl_output_get_user_data(wl_output);
         struct toplevel_output *pos, *tmp;
+
+        toplevel_count(toplevel, -1);
         wl_list_for_each_safe(pos, tmp, &toplevel->output_list, link){
-                if (pos->dunst_output->name == output->name) {
+                if (pos->dunst_output == output) {
                         wl_list_remove(&pos->link);
+                        free(pos);
+                }
+        }
+        toplevel_count(toplevel, 1);
+}
+
+void toplevel_output_removed(struct dunst_output *output) {
+        struct toplevel_v1 *toplevel;
+        wl_list_for_each(toplevel, &toplevel_list, link) {
+                toplevel_count(toplevel, -1);
+
+                struct toplevel_output *pos, *tmp;
+                wl_list_for_each_safe(pos, tmp, &toplevel->output_list, link){
+                        if (pos->dunst_output == output) {
+                                wl_list_remove(&pos->link);
+                                free(pos);
+                        }
                 }
+
+                toplevel_count(toplevel, 1);
         }
 }
 
@@ -77,7 +118,13 @@ static void toplevel_handle_done(void *data,
         struct toplevel_v1 *toplevel = data;
 
         bool was_fullscreen = wl_have_fullscreen_window();
+
+        toplevel_count(toplevel, -1);
         copy_state(&toplevel->current, &toplevel->pending);
+        toplevel->counted = toplevel->current.state & TOPLEVEL_STATE_FULLSCREEN &&
+                            toplevel->current.state & TOPLEVEL_STATE_ACTIVATED;
+        toplevel_count(toplevel, 1);
+
         bool is_fullscreen = wl_have_fullscreen_window();
 
         if (was_fullscreen != is_fullscreen) {
@@ -89,6 +136,9 @@ static void toplevel_handle_closed(void *data,
                 struct zwlr_foreign_toplevel_handle_v1 *zwlr_toplevel) {
         struct toplevel_v1 *toplevel = data;
 
+        bool was_fullscreen = wl_have_fullscreen_window();
+        toplevel_count(toplevel, -1);
+
         wl_list_remove(&toplevel->link);
         struct toplevel_output *pos, *tmp;
         wl_list_for_each_safe(pos, tmp, &toplevel->output_list, link){
@@ -96,6 +146,10 @@ static void toplevel_handle_closed(void *data,
         }
         free(toplevel);
         zwlr_foreign_toplevel_handle_v1_destroy(zwlr_toplevel);
+
+        if (was_fullscreen != wl_have_fullscreen_window()) {
+                wake_up();
+        }
 }
 
 static const struct zwlr_foreign_toplevel_handle_v1_listener toplevel_impl = {
@@ -1,5 +1,6 @@
 #ifndef DUNST_FOREIGN_TOPLEVEL_H
 #define DUNST_FOREIGN_TOPLEVEL_H
+#include <stdbool.h>
 #include <wayland-client.h>
 
 enum toplevel_state_field {
@@ -19,6 +20,7 @@ struct toplevel_v1 {
 
         uint32_t id;
         struct toplevel_state current, pending;
+        bool counted; // included in the fullscreen counters
 };
 
 struct toplevel_output {
@@ -29,5 +31,16 @@ struct toplevel_output {
 extern const struct zwlr_foreign_toplevel_manager_v1_listener toplevel_manager_impl;
 
 extern struct wl_list toplevel_list;
+
+// Activated fullscreen toplevels, which are on any output
+extern unsigned int toplevel_fullscreen_count;
+
+struct dunst_output;
+
+/**
+ * Forget about \p output being part of any toplevel, before it gets
+ * destroyed.
+ */
+void toplevel_output_removed(struct dunst_output *output);
 #endif
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -62,48 +62,63 @@ static const struct wl_buffer_listener buffer_listener = {
 	.release = buffer_handle_release,
 };
 
-static struct pool_buffer *create_buffer(struct wl_shm *shm,
-		struct pool_buffer *buf, int32_t width, int32_t height) {
+// Round the size of the memory up, so it can be reused for a while, when
+// the notifications grow or shrink
+static size_t size_class(size_t size) {
+	size_t class = POOL_BUFFER_MIN_SIZE;
+	while (class < size) {
+		class *= 2;
+	}
+	return class;
+}
+
+static bool create_pool(struct wl_shm *shm, struct pool_buffer *buf,
+		size_t capacity) {
+	int fd = create_shm_file(capacity);
+	if (fd == -1) {
+		return false;
+	}
+
+	void *data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	buf->pool = wl_shm_create_pool(shm, fd, capacity);
+	buf->data = data;
+	buf->capacity = capacity;
+
+	close(fd);
+	return true;
+}
+
+static struct pool_buffer *create_buffer(struct pool_buffer *buf,
+		int32_t width, int32_t height) {
 	const enum wl_shm_format wl_fmt = WL_SHM_FORMAT_ARGB8888;
 	const cairo_format_t cairo_fmt = CAIRO_FORMAT_ARGB32;
 
 	uint32_t stride = cairo_format_stride_for_width(cairo_fmt, width);
 	size_t size = stride * height;
 
-	void *data = NULL;
 	if (size > 0) {
-		int fd = create_shm_file(size);
-		if (fd == -1) {
-			return NULL;
-		}
-
-		data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-		if (data == MAP_FAILED) {
-			close(fd);
-			return NULL;
-		}
-
-		struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, size);
 		buf->buffer =
-			wl_shm_pool_create_buffer(pool, 0, width, height, stride, wl_fmt);
+			wl_shm_pool_create_buffer(buf->pool, 0, width, height, stride, wl_fmt);
 		wl_buffer_add_listener(buf->buffer, &buffer_listener, buf);
-		wl_shm_pool_destroy(pool);
-
-		close(fd);
 	}
 
-	buf->data = data;
 	buf->size = size;
 	buf->width = width;
 	buf->height = height;
-	buf->surface = cairo_image_surface_create_for_data(data, cairo_fmt, width,
+	buf->surface = cairo_image_surface_create_for_data(buf->data, cairo_fmt, width,
 		height, stride);
 	buf->cairo = cairo_create(buf->surface);
 	buf->pango = pango_cairo_create_context(buf->cairo);
 	return buf;
 }
 
-void finish_buffer(struct pool_buffer *buffer) {
+// Destroy the buffer, but keep its memory to create another one in it
+static void release_buffer(struct pool_buffer *buffer) {
 	if (buffer->buffer) {
 		wl_buffer_destroy(buffer->buffer);
 	}
@@ -116,35 +131,89 @@ void finish_buffer(struct pool_buffer *buffer) {
 	if (buffer->pango) {
 		g_object_unref(buffer->pango);
 	}
+	buffer->buffer = NULL;
+	buffer->cairo = NULL;
+	buffer->surface = NULL;
+	buffer->pango = NULL;
+	buffer->width = buffer->height = 0;
+	buffer->size = 0;
+}
+
+// Whether the memory of the buffer is enough for size bytes, but also not
+// way more than that. Memory left over from a large frame gets given back.
+static bool buffer_suits(const struct pool_buffer *buffer, size_t size) {
+	return buffer->capacity >= size && size_class(size) > buffer->capacity / 4;
+}
+
+void finish_buffer(struct pool_buffer *buffer) {
+	release_buffer(buffer);
+	if (buffer->pool) {
+		wl_shm_pool_destroy(buffer->pool);
+	}
 	if (buffer->data) {
-		munmap(buffer->data, buffer->size);
+		munmap(buffer->data, buffer->capacity);
 	}
 	memset(buffer, 0, sizeof(struct pool_buffer));
 }
 
+// The rows of buffer, which differ from the ones of the buffer shown before.
+// Everything differs, if shown is NULL or of another size.
+void buffer_damage_rows(const struct pool_buffer *buffer,
+		const struct pool_buffer *shown, int32_t *y, int32_t *height) {
+	*y = 0;
+	*height = buffer->height;
+	if (!shown || shown == buffer || !shown->surface || !buffer->height
+			|| shown->width != buffer->width || shown->height != buffer->height) {
+		return;
+	}
+
+	size_t stride = buffer->size / buffer->height;
+	const uint8_t *a = buffer->data;
+	const uint8_t *b = shown->data;
+
+	int32_t first = 0, last = buffer->height;
+	while (first < last && memcmp(a + first * stride, b + first * stride, stride) == 0) {
+		first++;
+	}
+	while (last > first && memcmp(a + (last - 1) * stride, b + (last - 1) * stride, stride) == 0) {
+		last--;
+	}
+
+	*y = first;
+	*height = last - first;
+}
+
 struct pool_buffer *get_next_buffer(struct wl_shm *shm,
-		struct pool_buffer pool[static 2], uint32_t width, uint32_t height) {
+		struct pool_buffer pool[static POOL_BUFFER_COUNT], uint32_t width, uint32_t height) {
+	size_t size = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width) * height;
+
+	// Prefer a buffer of the same size, then one with suitable memory
 	struct pool_buffer *buffer = NULL;
-	for (size_t i = 0; i < 2; ++i) {
+	for (size_t i = 0; i < POOL_BUFFER_COUNT; ++i) {
 		if (pool[i].busy) {
 			continue;
 		}
-		buffer = &pool[i];
+		bool suits = buffer_suits(&pool[i], size);
+		if (suits && pool[i].surface && pool[i].width == width && pool[i].height == height) {
+			return &pool[i];
+		}
+		if (!buffer || (suits && !buffer_suits(buffer, size))) {
+			buffer = &pool[i];
+		}
 	}
 	if (!buffer) {
 		return NULL;
 	}
 
-	if (buffer->width != width || buffer->height != height) {
-		finish_buffer(buffer);
-	}
+	release_buffer(buffer);
 
-	if (!buffer->buffer) {
-		if (!create_buffer(shm, buffer, width, height)) {
+	if (!buffer_suits(buffer, size)) {
+		finish_buffer(buffer);
+		if (!create_pool(shm, buffer, size_class(size))) {
 			return NULL;
 		}
 	}
 
-	return buffer;
+	return create_buffer(buffer, width, height);
 }
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
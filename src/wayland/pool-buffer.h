@@ -7,7 +7,14 @@
 #include <stdint.h>
 #include <wayland-client.h>
 
+// Enough for one buffer on the screen, one waiting to be shown and one to
+// draw the next frame into
+#define POOL_BUFFER_COUNT 3
+// The smallest memory allocated for a buffer, bigger ones double in size
+#define POOL_BUFFER_MIN_SIZE (64 * 1024)
+
 struct pool_buffer {
+	struct wl_shm_pool *pool;
 	struct wl_buffer *buffer;
 	cairo_surface_t *surface;
 	cairo_t *cairo;
@@ -15,12 +22,15 @@ struct pool_buffer {
 	uint32_t width, height;
 	void *data;
 	size_t size;
+	size_t capacity; // size of the memory mapped for the buffer
 	bool busy;
 };
 
 struct pool_buffer *get_next_buffer(struct wl_shm *shm,
-	struct pool_buffer pool[static 2], uint32_t width, uint32_t height);
+	struct pool_buffer pool[static POOL_BUFFER_COUNT], uint32_t width, uint32_t height);
 void finish_buffer(struct pool_buffer *buffer);
+void buffer_damage_rows(const struct pool_buffer *buffer,
+	const struct pool_buffer *shown, int32_t *y, int32_t *height);
 
 #endif
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -16,6 +16,7 @@
 #include <unistd.h>
 #include <linux/input-event-codes.h>
 #include <string.h>
+#include <math.h>
 #include <glib.h>
 
 #include "protocols/xdg-shell-client-header.h"
@@ -26,6 +27,10 @@
 #include "protocols/wlr-foreign-toplevel-management-unstable-v1.h"
 #include "protocols/idle-client-header.h"
 #include "protocols/idle.h"
+#include "protocols/viewporter-client-header.h"
+#include "protocols/viewporter.h"
+#include "protocols/fractional-scale-v1-client-header.h"
+#include "protocols/fractional-scale-v1.h"
 #include "pool-buffer.h"
 
 
@@ -44,6 +49,28 @@ struct window_wl {
         cairo_t * c_ctx;
 };
 
+// A layer surface showing the notifications on one output. It only gets
+// unmapped when it's hidden, so it can be shown again without setting it up
+// from scratch.
+struct dunst_layer {
+        struct wl_list link;
+        struct dunst_output *output; // NULL lets the compositor choose
+
+        struct wl_surface *surface;
+        struct dunst_output *surface_output;
+        struct zwlr_layer_surface_v1 *layer_surface;
+        struct wp_viewport *viewport;
+        struct wp_fractional_scale_v1 *fractional_scale;
+        uint32_t preferred_scale; // in 120ths, 0 if unknown
+        struct wl_callback *frame_callback;
+        bool mapped;
+        bool configured;
+        bool configure_pending; // waiting for the configure answering a resize
+
+        int32_t width, height;
+        int32_t requested_width, requested_height; // size last asked for
+};
+
 struct wl_ctx {
         GWaterWaylandSource *esrc;
         struct wl_display *display; // owned by esrc
@@ -51,20 +78,18 @@ struct wl_ctx {
         struct wl_compositor *compositor;
         struct wl_shm *shm;
         struct zwlr_layer_shell_v1 *layer_shell;
+        struct wp_viewporter *viewporter;
+        struct wp_fractional_scale_manager_v1 *fractional_scale_manager;
         struct wl_seat *seat;
 
         struct wl_list outputs;
 
-        struct wl_surface *surface;
-        struct dunst_output *surface_output;
-        struct zwlr_layer_surface_v1 *layer_surface;
-        struct dunst_output *layer_surface_output;
-        struct wl_callback *frame_callback;
+        struct wl_list layers;
+        struct dunst_layer *layer; // the layer showing the notifications
         struct org_kde_kwin_idle *idle_handler;
         struct org_kde_kwin_idle_timeout *idle_timeout;
         uint32_t toplevel_manager_name;
         struct zwlr_foreign_toplevel_manager_v1 *toplevel_manager;
-        bool configured;
         bool dirty;
         bool is_idle;
         bool has_idle_monitor;
@@ -83,9 +108,10 @@ struct wl_ctx {
 
         struct dimensions cur_dim;
 
-        int32_t width, height;
-        struct pool_buffer buffers[2];
+        struct pool_buffer buffers[POOL_BUFFER_COUNT];
         struct pool_buffer *current_buffer;
+        struct pool_buffer *shown_buffer; // still holds what the compositor shows
+        double shown_scale;
         struct wl_cursor_theme *cursor_theme;
         const struct wl_cursor_image *cursor_image;
         struct wl_surface *cursor_surface;
@@ -142,7 +168,7 @@ static void create_output( struct wl_output *wl_output, uint32_t global_name) {
         output->global_name = global_name;
         output->wl_output = wl_output;
         output->scale = 1;
-        output->fullscreen = false;
+        output->fullscreen_count = 0;
 
         recreate_surface = wl_list_empty(&ctx.outputs);
 
@@ -154,21 +180,36 @@ static void create_output( struct wl_output *wl_output, uint32_t global_name) {
 
         if (recreate_surface) {
                 // We had no outputs, force our surface to redraw
-                set_dirty(ctx.surface);
+                set_dirty();
         }
 }
 
+static struct dunst_layer *layer_find(struct dunst_output *output);
+static void layer_destroy(struct dunst_layer *layer);
+
 static void destroy_output(struct dunst_output *output) {
-        if (ctx.surface_output == output) {
-                ctx.surface_output = NULL;
+        struct dunst_layer *layer;
+        wl_list_for_each(layer, &ctx.layers, link) {
+                if (layer->surface_output == output)
+                        layer->surface_output = NULL;
         }
-        if (ctx.layer_surface_output == output) {
-                ctx.layer_surface_output = NULL;
+
+        bool shown = false;
+        if ((layer = layer_find(output))) {
+                shown = layer == ctx.layer;
+                layer_destroy(layer);
         }
+
+        toplevel_output_removed(output);
+
         wl_list_remove(&output->link);
         wl_output_destroy(output->wl_output);
         free(output->name);
         free(output);
+
+        // Show the notifications somewhere else
+        if (shown)
+                set_dirty();
 }
 
 static void touch_handle_motion(void *data, struct wl_touch *wl_touch,
@@ -267,15 +308,17 @@ static const struct wl_seat_listener seat_listener = {
 
 static void surface_handle_enter(void *data, struct wl_surface *surface,
                 struct wl_output *wl_output) {
+        struct dunst_layer *layer = data;
         // Don't bother keeping a list of outputs, a layer surface can only be on
         // one output a a time
-        ctx.surface_output = wl_output_get_user_data(wl_output);
+        layer->surface_output = wl_output_get_user_data(wl_output);
         set_dirty();
 }
 
 static void surface_handle_leave(void *data, struct wl_surface *surface,
                 struct wl_output *wl_output) {
-        ctx.surface_output = NULL;
+        struct dunst_layer *layer = data;
+        layer->surface_output = NULL;
 }
 
 static const struct wl_surface_listener surface_listener = {
@@ -283,6 +326,23 @@ static const struct wl_surface_listener surface_listener = {
         .leave = surface_handle_leave,
 };
 
+static void fractional_scale_handle_preferred_scale(void *data,
+                struct wp_fractional_scale_v1 *fractional_scale, uint32_t scale) {
+        struct dunst_layer *layer = data;
+        if (layer->preferred_scale == scale)
+                return;
+
+        LOG_D("Preferred scale %.3f", scale / 120.0);
+        layer->preferred_scale = scale;
+
+        // The layouts have to be set up for the new scale
+        wake_up();
+}
+
+static const struct wp_fractional_scale_v1_listener fractional_scale_listener = {
+        .preferred_scale = fractional_scale_handle_preferred_scale,
+};
+
 
 static void schedule_frame_and_commit();
 static void send_frame();
@@ -290,46 +350,45 @@ static void send_frame();
 static void layer_surface_handle_configure(void *data,
                 struct zwlr_layer_surface_v1 *surface,
                 uint32_t serial, uint32_t width, uint32_t height) {
+        struct dunst_layer *layer = data;
         zwlr_layer_surface_v1_ack_configure(surface, serial);
 
-        if (ctx.configured &&
-                        ctx.width == (int32_t) width &&
-                        ctx.height == (int32_t) height) {
-                wl_surface_commit(ctx.surface);
+        // This may be the answer to the size we requested. Even if it's not
+        // the size we asked for, we have to draw with what we got.
+        bool answered = layer->configure_pending;
+        layer->configure_pending = false;
+
+        // A size of zero leaves it up to us
+        if (width == 0)
+                width = layer->requested_width;
+        if (height == 0)
+                height = layer->requested_height;
+
+        if (!answered && layer->configured &&
+                        layer->width == (int32_t) width &&
+                        layer->height == (int32_t) height) {
+                wl_surface_commit(layer->surface);
                 return;
         }
 
-        ctx.configured = true;
-        ctx.width = width;
-        ctx.height = height;
+        layer->configured = true;
+        layer->width = width;
+        layer->height = height;
 
-        send_frame();
+        if (layer == ctx.layer)
+                send_frame();
 }
 
 static void layer_surface_handle_closed(void *data,
                 struct zwlr_layer_surface_v1 *surface) {
+        struct dunst_layer *layer = data;
         LOG_I("Destroying layer");
-        if (ctx.layer_surface)
-                zwlr_layer_surface_v1_destroy(ctx.layer_surface);
-        ctx.layer_surface = NULL;
 
-        if (ctx.surface)
-                wl_surface_destroy(ctx.surface);
-        ctx.surface = NULL;
-
-        if (ctx.frame_callback) {
-                wl_callback_destroy(ctx.frame_callback);
-                ctx.frame_callback = NULL;
-                ctx.dirty = true;
-        }
+        bool shown = layer == ctx.layer;
+        layer_destroy(layer);
 
-        if (ctx.configured) {
-                ctx.configured = false;
-                ctx.width = ctx.height = 0;
+        if (shown) {
                 ctx.dirty = true;
-        }
-
-        if (ctx.dirty) {
                 schedule_frame_and_commit();
         }
 }
@@ -339,6 +398,99 @@ static const struct zwlr_layer_surface_v1_listener layer_surface_listener = {
         .closed = layer_surface_handle_closed,
 };
 
+static struct dunst_layer *layer_find(struct dunst_output *output) {
+        struct dunst_layer *layer;
+        wl_list_for_each(layer, &ctx.layers, link) {
+                if (layer->output == output)
+                        return layer;
+        }
+        return NULL;
+}
+
+static struct dunst_layer *layer_create(struct dunst_output *output) {
+        struct dunst_layer *layer = g_malloc0(sizeof(struct dunst_layer));
+        struct wl_output *wl_output = NULL;
+        if (output != NULL) {
+                wl_output = output->wl_output;
+        }
+
+        layer->output = output;
+        layer->surface = wl_compositor_create_surface(ctx.compositor);
+        wl_surface_add_listener(layer->surface, &surface_listener, layer);
+
+        // Render at the exact scale of the output, when the compositor
+        // supports it. Otherwise the buffer scale has to be an integer and
+        // the compositor scales the surface down again.
+        if (ctx.viewporter && ctx.fractional_scale_manager) {
+                layer->viewport = wp_viewporter_get_viewport(ctx.viewporter,
+                                layer->surface);
+                layer->fractional_scale = wp_fractional_scale_manager_v1_get_fractional_scale(
+                                ctx.fractional_scale_manager, layer->surface);
+                wp_fractional_scale_v1_add_listener(layer->fractional_scale,
+                                &fractional_scale_listener, layer);
+        }
+
+        layer->layer_surface = zwlr_layer_shell_v1_get_layer_surface(
+                ctx.layer_shell, layer->surface, wl_output,
+                settings.layer, "notifications");
+        zwlr_layer_surface_v1_add_listener(layer->layer_surface,
+                &layer_surface_listener, layer);
+
+        wl_list_insert(&ctx.layers, &layer->link);
+        return layer;
+}
+
+static void layer_destroy(struct dunst_layer *layer) {
+        if (ctx.layer == layer) {
+                ctx.layer = NULL;
+                ctx.shown_buffer = NULL;
+        }
+
+        if (layer->frame_callback)
+                wl_callback_destroy(layer->frame_callback);
+        zwlr_layer_surface_v1_destroy(layer->layer_surface);
+        if (layer->fractional_scale)
+                wp_fractional_scale_v1_destroy(layer->fractional_scale);
+        if (layer->viewport)
+                wp_viewport_destroy(layer->viewport);
+        wl_surface_destroy(layer->surface);
+
+        wl_list_remove(&layer->link);
+        g_free(layer);
+}
+
+// Hide the layer, but keep it to show the notifications on its output again
+static void layer_unmap(struct dunst_layer *layer) {
+        if (ctx.layer == layer) {
+                ctx.layer = NULL;
+                ctx.shown_buffer = NULL;
+        }
+
+        if (layer->frame_callback) {
+                wl_callback_destroy(layer->frame_callback);
+                layer->frame_callback = NULL;
+        }
+
+        // A layer that never got shown may still wait for its configure,
+        // there is no point in keeping it in that state
+        if (!layer->mapped) {
+                layer_destroy(layer);
+                return;
+        }
+
+        // Without a buffer the surface gets unmapped and the layer surface
+        // returns to the state right after creating it. Mapping it again
+        // only needs the initial commit and configure.
+        wl_surface_attach(layer->surface, NULL, 0, 0);
+        wl_surface_commit(layer->surface);
+
+        layer->mapped = false;
+        layer->configured = false;
+        layer->configure_pending = false;
+        layer->width = layer->height = 0;
+        layer->requested_width = layer->requested_height = 0;
+}
+
 
 static void idle_start (void *data, struct org_kde_kwin_idle_timeout *org_kde_kwin_idle_timeout) {
         ctx.is_idle = true;
@@ -347,6 +499,9 @@ static void idle_start (void *data, struct org_kde_kwin_idle_timeout *org_kde_kw
 static void idle_stop (void *data, struct org_kde_kwin_idle_timeout *org_kde_kwin_idle_timeout) {
         ctx.is_idle = false;
         LOG_D("User isn't idle anymore");
+
+        // Catch up with what got skipped while being idle
+        wake_up();
 }
 
 static const struct org_kde_kwin_idle_timeout_listener idle_timeout_listener = {
@@ -411,6 +566,12 @@ static void handle_global(void *data, struct wl_registry *registry,
         } else if (strcmp(interface, zwlr_layer_shell_v1_interface.name) == 0) {
                 ctx.layer_shell = wl_registry_bind(registry, name,
                                 &zwlr_layer_shell_v1_interface, 1);
+        } else if (strcmp(interface, wp_viewporter_interface.name) == 0) {
+                ctx.viewporter = wl_registry_bind(registry, name,
+                                &wp_viewporter_interface, 1);
+        } else if (strcmp(interface, wp_fractional_scale_manager_v1_interface.name) == 0) {
+                ctx.fractional_scale_manager = wl_registry_bind(registry, name,
+                                &wp_fractional_scale_manager_v1_interface, 1);
         } else if (strcmp(interface, wl_seat_interface.name) == 0) {
                 ctx.seat = wl_registry_bind(registry, name, &wl_seat_interface, 3);
                 wl_seat_add_listener(ctx.seat, &seat_listener, ctx.seat);
@@ -448,6 +609,7 @@ static const struct wl_registry_listener registry_listener = {
 
 bool wl_init() {
         wl_list_init(&ctx.outputs);
+        wl_list_init(&ctx.layers);
         wl_list_init(&toplevel_list);
         //wl_list_init(&ctx.seats); // TODO multi-seat support
 
@@ -549,14 +711,12 @@ void wl_deinit() {
         // We need to check if any of these are NULL, since the initialization
         // could have been aborted half way through, or the compositor doesn't
         // support some of these features.
-        if (ctx.layer_surface != NULL) {
-                zwlr_layer_surface_v1_destroy(ctx.layer_surface);
-        }
-        if (ctx.surface != NULL) {
-                wl_surface_destroy(ctx.surface);
+        struct dunst_layer *layer, *layer_tmp;
+        wl_list_for_each_safe(layer, layer_tmp, &ctx.layers, link) {
+                layer_destroy(layer);
         }
-        finish_buffer(&ctx.buffers[0]);
-        finish_buffer(&ctx.buffers[1]);
+        for (size_t i = 0; i < POOL_BUFFER_COUNT; i++)
+                finish_buffer(&ctx.buffers[i]);
 
         // The output list is initialized at the start of init, so no need to
         // check for NULL
@@ -581,6 +741,12 @@ void wl_deinit() {
         if (ctx.layer_shell)
                 zwlr_layer_shell_v1_destroy(ctx.layer_shell);
 
+        if (ctx.viewporter)
+                wp_viewporter_destroy(ctx.viewporter);
+
+        if (ctx.fractional_scale_manager)
+                wp_fractional_scale_manager_v1_destroy(ctx.fractional_scale_manager);
+
         if (ctx.compositor)
                 wl_compositor_destroy(ctx.compositor);
 
@@ -603,7 +769,7 @@ static void schedule_frame_and_commit();
 
 // Draw and commit a new frame.
 static void send_frame() {
-        int scale = wl_get_scale();
+        double scale = wl_get_scale();
 
         if (wl_list_empty(&ctx.outputs)) {
                 ctx.dirty = false;
@@ -614,20 +780,11 @@ static void send_frame() {
         int height = ctx.cur_dim.h;
         int width = ctx.cur_dim.w;
 
-        // There are two cases where we want to tear down the surface: zero
-        // notifications (height = 0) or moving between outputs.
-        if (height == 0 || ctx.layer_surface_output != output) {
-                if (ctx.layer_surface != NULL) {
-                        zwlr_layer_surface_v1_destroy(ctx.layer_surface);
-                        ctx.layer_surface = NULL;
-                }
-                if (ctx.surface != NULL) {
-                        wl_surface_destroy(ctx.surface);
-                        ctx.surface = NULL;
-                }
-                ctx.width = ctx.height = 0;
-                ctx.surface_output = NULL;
-                ctx.configured = false;
+        // There are two cases where we want to hide the surface: zero
+        // notifications (height = 0) or moving between outputs. The layer
+        // is kept, in case the notifications get shown on its output again.
+        if (ctx.layer != NULL && (height == 0 || ctx.layer->output != output)) {
+                layer_unmap(ctx.layer);
         }
 
         {
@@ -643,7 +800,7 @@ static void send_frame() {
                 }
         }
 
-        // If there are no notifications, there's no point in recreating the
+        // If there are no notifications, there's no point in showing the
         // surface right now.
         if (height == 0) {
                 ctx.dirty = false;
@@ -651,49 +808,38 @@ static void send_frame() {
         }
 
         // If we've made it here, there is something to draw. If the surface
-        // doesn't exist (this is the first notification, or we moved to a
-        // different output), we need to create it.
-        if (ctx.layer_surface == NULL) {
-                struct wl_output *wl_output = NULL;
-                if (output != NULL) {
-                        wl_output = output->wl_output;
-                }
-                ctx.layer_surface_output = output;
-                ctx.surface = wl_compositor_create_surface(ctx.compositor);
-                wl_surface_add_listener(ctx.surface, &surface_listener, NULL);
-
-                ctx.layer_surface = zwlr_layer_shell_v1_get_layer_surface(
-                        ctx.layer_shell, ctx.surface, wl_output,
-                        settings.layer, "notifications");
-                zwlr_layer_surface_v1_add_listener(ctx.layer_surface,
-                        &layer_surface_listener, NULL);
-
-                // Because we're creating a new surface, we aren't going to draw
-                // anything into it during this call. We don't know what size the
-                // surface will be until we've asked the compositor for what we want
-                // and it has responded with what it actually gave us. We also know
-                // that the height we would _like_ to draw (greater than zero, or we
-                // would have bailed already) is different from our ctx.height
-                // (which has to be zero here), so we can fall through to the next
+        // isn't shown (this is the first notification, or we moved to a
+        // different output), we need to map the layer of that output or
+        // create it, if there is none yet.
+        if (ctx.layer == NULL) {
+                ctx.layer = layer_find(output);
+                if (ctx.layer == NULL)
+                        ctx.layer = layer_create(output);
+
+                // Either way, we aren't going to draw anything into it during
+                // this call. We don't know what size the surface will be until
+                // we've asked the compositor for what we want and it has
+                // responded with what it actually gave us. An unmapped layer
+                // has no requested size, so we can fall through to the next
                 // block to let it set the size for us.
         }
 
-        assert(ctx.layer_surface);
+        struct dunst_layer *layer = ctx.layer;
 
         // We now want to resize the surface if it isn't the right size. If the
-        // surface is brand new, it doesn't even have a size yet. If it already
-        // exists, we might need to resize if the list of notifications has changed
-        // since the last time we drew.
-        if (ctx.height != height || ctx.width != width) {
+        // surface is freshly mapped, it doesn't even have a size yet. If it
+        // is shown already, we might need to resize if the list of
+        // notifications has changed since the last time we drew.
+        if (layer->requested_height != height || layer->requested_width != width) {
                 struct dimensions dim = ctx.cur_dim;
                 // Set window size
-                zwlr_layer_surface_v1_set_size(ctx.layer_surface,
+                zwlr_layer_surface_v1_set_size(layer->layer_surface,
                                 dim.w, dim.h);
 
                 // Put the window at the right position
-                zwlr_layer_surface_v1_set_anchor(ctx.layer_surface,
+                zwlr_layer_surface_v1_set_anchor(layer->layer_surface,
                         settings.origin);
-                zwlr_layer_surface_v1_set_margin(ctx.layer_surface,
+                zwlr_layer_surface_v1_set_margin(layer->layer_surface,
                                 // Offsets where no anchors are specified are
                                 // ignored. We can safely assume the offset is
                                 // positive.
@@ -702,31 +848,55 @@ static void send_frame() {
                                 settings.offset.y, // bottom
                                 settings.offset.x);// left
 
-                wl_surface_commit(ctx.surface);
+                wl_surface_commit(layer->surface);
+                wl_display_flush(ctx.display);
+
+                layer->requested_width = width;
+                layer->requested_height = height;
+                layer->configure_pending = true;
 
                 // Now we're going to bail without drawing anything. This gives the
-                // compositor a chance to create the surface and tell us what size we
+                // compositor a chance to map the surface and tell us what size we
                 // were actually granted, which may be smaller than what we asked for
                 // depending on the screen size and layout of other layer surfaces.
                 // This information is provided in layer_surface_handle_configure,
-                // which will then call send_frame again. When that call happens, the
-                // layer surface will exist and the height will hopefully match what
-                // we asked for. That means we won't return here, and will actually
-                // draw into the surface down below.
-                // TODO: If the compositor doesn't send a configure with the size we
-                // requested, we'll enter an infinite loop. We need to keep track of
-                // the fact that a request was sent separately from what height we are.
-                wl_display_roundtrip(ctx.display);
+                // which will then call send_frame again. As the request is
+                // tracked separately from the granted size, that call draws
+                // into the surface down below, even if the compositor didn't
+                // give us the size we asked for.
                 return;
         }
 
-        assert(ctx.configured);
+        // The frame gets sent, once the compositor answered the resize
+        if (layer->configure_pending)
+                return;
+
+        assert(layer->configured);
 
         // Yay we can finally draw something!
-        wl_surface_set_buffer_scale(ctx.surface, scale);
-        wl_surface_damage_buffer(ctx.surface, 0, 0, INT32_MAX, INT32_MAX);
-        wl_surface_attach(ctx.surface, ctx.current_buffer->buffer, 0, 0);
+        if (layer->viewport) {
+                // The buffer keeps a scale of 1, the viewport maps it onto
+                // the size of the notifications
+                wp_viewport_set_destination(layer->viewport, width, height);
+        } else {
+                wl_surface_set_buffer_scale(layer->surface, scale);
+        }
+
+        // The compositor only has to upload the rows that changed since the
+        // last frame
+        if (ctx.shown_scale != scale)
+                ctx.shown_buffer = NULL;
+        int32_t damage_y, damage_height;
+        buffer_damage_rows(ctx.current_buffer, ctx.shown_buffer, &damage_y, &damage_height);
+        if (damage_height > 0)
+                wl_surface_damage_buffer(layer->surface, 0, damage_y,
+                                ctx.current_buffer->width, damage_height);
+
+        wl_surface_attach(layer->surface, ctx.current_buffer->buffer, 0, 0);
         ctx.current_buffer->busy = true;
+        ctx.shown_buffer = ctx.current_buffer;
+        ctx.shown_scale = scale;
+        layer->mapped = true;
 
         // Schedule a frame in case the state becomes dirty again
         schedule_frame_and_commit();
@@ -736,11 +906,12 @@ static void send_frame() {
 
 static void frame_handle_done(void *data, struct wl_callback *callback,
                 uint32_t time) {
-        wl_callback_destroy(ctx.frame_callback);
-        ctx.frame_callback = NULL;
+        struct dunst_layer *layer = data;
+        wl_callback_destroy(layer->frame_callback);
+        layer->frame_callback = NULL;
 
         // Only draw again if we need to
-        if (ctx.dirty) {
+        if (layer == ctx.layer && ctx.dirty) {
                 send_frame();
         }
 }
@@ -750,17 +921,17 @@ static const struct wl_callback_listener frame_listener = {
 };
 
 static void schedule_frame_and_commit() {
-        if (ctx.frame_callback) {
+        if (ctx.layer == NULL) {
+                // We don't show a surface yet, map or create it immediately
+                send_frame();
                 return;
         }
-        if (ctx.surface == NULL) {
-                // We don't yet have a surface, create it immediately
-                send_frame();
+        if (ctx.layer->frame_callback) {
                 return;
         }
-        ctx.frame_callback = wl_surface_frame(ctx.surface);
-        wl_callback_add_listener(ctx.frame_callback, &frame_listener, NULL);
-        wl_surface_commit(ctx.surface);
+        ctx.layer->frame_callback = wl_surface_frame(ctx.layer->surface);
+        wl_callback_add_listener(ctx.layer->frame_callback, &frame_listener, ctx.layer);
+        wl_surface_commit(ctx.layer->surface);
 }
 
 void set_dirty() {
@@ -779,6 +950,10 @@ window wl_win_create(void) {
 void wl_win_destroy(window winptr) {
         struct window_wl *win = (struct window_wl*)winptr;
         // FIXME: Dealloc everything
+        if (win->c_ctx)
+                cairo_destroy(win->c_ctx);
+        if (win->c_surface)
+                cairo_surface_destroy(win->c_surface);
         g_free(win);
 }
 
@@ -791,43 +966,68 @@ void wl_win_hide(window win) {
         LOG_I("Wayland: Hiding window");
         ctx.cur_dim.h = 0;
         set_dirty();
-        wl_display_roundtrip(ctx.display);
+        wl_display_flush(ctx.display);
 }
 
 void wl_display_surface(cairo_surface_t *srf, window winptr, const struct dimensions* dim) {
         /* struct window_wl *win = (struct window_wl*)winptr; */
-        int scale = wl_get_scale();
-        LOG_D("Buffer size (scaled) %ix%i", dim->w * scale, dim->h * scale);
-        ctx.current_buffer = get_next_buffer(ctx.shm, ctx.buffers,
-                        dim->w * scale, dim->h * scale);
-
-        if(ctx.current_buffer == NULL) {
-                return;
+        double scale = wl_get_scale();
+        int width = round(dim->w * scale);
+        int height = round(dim->h * scale);
+        LOG_D("Buffer size (scaled) %ix%i", width, height);
+
+        // Usually the frame got drawn straight into the buffer returned by
+        // wl_win_get_surface, so there is nothing to copy.
+        if (ctx.current_buffer == NULL || srf != ctx.current_buffer->surface) {
+                ctx.current_buffer = get_next_buffer(ctx.shm, ctx.buffers,
+                                width, height);
+
+                if(ctx.current_buffer == NULL) {
+                        return;
+                }
+                // It is about to be drawn over
+                if (ctx.current_buffer == ctx.shown_buffer)
+                        ctx.shown_buffer = NULL;
+
+                cairo_t *c = ctx.current_buffer->cairo;
+                cairo_save(c);
+                cairo_set_source_surface(c, srf, 0, 0);
+                cairo_rectangle(c, 0, 0, width, height);
+                cairo_fill(c);
+                cairo_restore(c);
         }
 
-        cairo_t *c = ctx.current_buffer->cairo;
-        cairo_save(c);
-        cairo_set_source_surface(c, srf, 0, 0);
-        cairo_rectangle(c, 0, 0, dim->w * scale, dim->h * scale);
-        cairo_fill(c);
-        cairo_restore(c);
-
         ctx.cur_dim = *dim;
 
+        // The frame gets sent, as soon as the compositor is ready for it.
+        // Until then, a newer frame simply replaces this one.
         set_dirty();
-        wl_display_roundtrip(ctx.display);
+        wl_display_flush(ctx.display);
 }
 
-cairo_t* wl_win_get_context(window winptr) {
-        struct window_wl *win = (struct window_wl*)winptr;
-        ctx.current_buffer = get_next_buffer(ctx.shm, ctx.buffers, 500, 500);
+cairo_surface_t* wl_win_get_surface(window winptr, int width, int height) {
+        ctx.current_buffer = get_next_buffer(ctx.shm, ctx.buffers, width, height);
 
         if(ctx.current_buffer == NULL) {
                 return NULL;
         }
+        // It is about to be drawn over
+        if (ctx.current_buffer == ctx.shown_buffer)
+                ctx.shown_buffer = NULL;
+
+        return ctx.current_buffer->surface;
+}
+
+cairo_t* wl_win_get_context(window winptr) {
+        struct window_wl *win = (struct window_wl*)winptr;
+
+        // The context is only used to measure the text, so it doesn't need
+        // a buffer shared with the compositor
+        if (!win->c_ctx) {
+                win->c_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+                win->c_ctx = cairo_create(win->c_surface);
+        }
 
-        win->c_surface = ctx.current_buffer->surface;
-        win->c_ctx = ctx.current_buffer->cairo;
         return win->c_ctx;
 }
 
@@ -867,33 +1067,24 @@ bool wl_is_idle(void) {
 }
 
 bool wl_have_fullscreen_window(void) {
+        // The counters get updated by the toplevel events
         struct dunst_output *current_output = get_configured_output();
-        uint32_t output_name = UINT32_MAX;
         if (current_output)
-                output_name = current_output->global_name;
-
-        struct toplevel_v1 *toplevel;
-	wl_list_for_each(toplevel, &toplevel_list, link) {
-                if (!(toplevel->current.state & TOPLEVEL_STATE_FULLSCREEN &&
-                                        toplevel->current.state &
-                                        TOPLEVEL_STATE_ACTIVATED))
-                        continue;
-
-                struct toplevel_output *pos;
-                wl_list_for_each(pos, &toplevel->output_list, link) {
-                        if (output_name == UINT32_MAX ||
-                                        pos->dunst_output->global_name ==
-                                        output_name) {
-                                return true;
-                        }
-                }
-        }
-        return false;
+                return current_output->fullscreen_count > 0;
+
+        return toplevel_fullscreen_count > 0;
 }
 
 double wl_get_scale(void) {
-        int scale = 0;
         struct dunst_output *output = get_configured_output();
+
+        // The layer of the output knows the exact scale, even while it's
+        // hidden
+        struct dunst_layer *layer = layer_find(output);
+        if (layer && layer->fractional_scale && layer->preferred_scale > 0)
+                return layer->preferred_scale / 120.0;
+
+        int scale = 0;
         if (output) {
                 scale = output->scale;
         } else {
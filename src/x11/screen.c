@@ -32,10 +32,52 @@ void randr_init(void);
 void randr_update(void);
 void xinerama_update(void);
 void screen_update_fallback(void);
+/*
+ * Return the child of the root window, which contains \p window.
+ */
+static Window get_toplevel_window(Window window)
+{
+        Window root, parent, *children;
+        unsigned int children_len;
+
+        while (XQueryTree(xctx.dpy, window, &root, &parent, &children, &children_len)) {
+                if (children)
+                        XFree(children);
+                if (!parent || parent == root)
+                        break;
+                window = parent;
+        }
+        return window;
+}
+
 static void x_follow_setup_error_handler(void);
 static int x_follow_tear_down_error_handler(void);
 static int FollowXErrorHandler(Display *display, XErrorEvent *e);
+static int XErrorHandlerFullscreen(Display *display, XErrorEvent *e);
 static Window get_focused_window(void);
+static Window get_toplevel_window(Window window);
+
+/**
+ * The fullscreen state of the focused window. It gets only queried again,
+ * after the events told it may have changed.
+ */
+static struct {
+        Window window;              /**< the focused window, whose events are selected */
+        bool fullscreen;
+        bool valid;                 /**< false, when the state has to be queried again */
+} fullscreen_cache;
+
+/**
+ * The screen get_active_screen() found last. Following the keyboard, it
+ * only changes along with the focused window. The pointer can't be tracked,
+ * so it's looked up at most once per frame when following the mouse.
+ */
+static struct {
+        int id;
+        bool valid;
+        bool follows_mouse;     /**< the pointer position determined the screen */
+        Window toplevel;        /**< the toplevel of the focused window, whose moves are selected */
+} active_screen_cache;
 
 
 /**
@@ -106,6 +148,7 @@ void init_screens(void)
 void alloc_screen_ar(int n)
 {
         assert(n > 0);
+        active_screen_cache.valid = false;
         g_free(screens);
         screens = g_malloc0(n * sizeof(struct screen_info));
         screens_len = n;
@@ -211,10 +254,127 @@ void screen_update_fallback(void)
         screens[0].h = DisplayHeight(xctx.dpy, screen);
 }
 
+/**
+ * Select the events of \p window, which the caches need. The window was
+ * tracked until now or is about to be.
+ */
+static void track_window_events(Window window)
+{
+        // Our own windows have their own event masks
+        if (!window || x_is_own_window(window))
+                return;
+
+        long mask = NoEventMask;
+        if (window == fullscreen_cache.window)
+                mask |= PropertyChangeMask | FocusChangeMask | StructureNotifyMask;
+        if (window == active_screen_cache.toplevel)
+                mask |= StructureNotifyMask;
+
+        XSelectInput(xctx.dpy, window, mask);
+}
+
+/**
+ * Listen to the property and focus changes of \p window instead of the
+ * previously focused one.
+ */
+static void fullscreen_track_window(Window window)
+{
+        Window old = fullscreen_cache.window;
+        if (window == old)
+                return;
+
+        fullscreen_cache.window = window;
+
+        XSetErrorHandler(XErrorHandlerFullscreen);
+        track_window_events(old);
+        track_window_events(window);
+        XSync(xctx.dpy, false);
+        XSetErrorHandler(NULL);
+}
+
+/**
+ * Listen to the moves of \p toplevel instead of the previous one. Focus
+ * proxies and the clients of reparenting window managers don't get a
+ * ConfigureNotify, when their toplevel moves to another screen.
+ */
+static void active_screen_track_toplevel(Window toplevel)
+{
+        Window old = active_screen_cache.toplevel;
+        if (toplevel == old)
+                return;
+
+        active_screen_cache.toplevel = toplevel;
+
+        XSetErrorHandler(XErrorHandlerFullscreen);
+        track_window_events(old);
+        track_window_events(toplevel);
+        XSync(xctx.dpy, false);
+        XSetErrorHandler(NULL);
+}
+
+/* see screen.h */
+bool fullscreen_check_event(const XEvent *ev)
+{
+        switch (ev->type) {
+        case PropertyNotify:
+                if (ev->xproperty.atom == xctx.atoms[ATOM_NET_ACTIVE_WINDOW]
+                    || (ev->xproperty.window == fullscreen_cache.window
+                        && ev->xproperty.atom == xctx.atoms[ATOM_NET_WM_STATE]))
+                        break;
+                return false;
+        case FocusIn:
+        case FocusOut:
+                break;
+        default:
+                return false;
+        }
+
+        fullscreen_cache.valid = false;
+        return true;
+}
+
+/* see screen.h */
+void screen_active_check_event(const XEvent *ev)
+{
+        switch (ev->type) {
+        case FocusIn:
+        case FocusOut:
+                active_screen_cache.valid = false;
+                break;
+        case PropertyNotify:
+                if (active_screen_cache.follows_mouse
+                    || ev->xproperty.atom == xctx.atoms[ATOM_NET_ACTIVE_WINDOW])
+                        active_screen_cache.valid = false;
+                break;
+        case ConfigureNotify:
+                // The focused window or any window below the pointer moved
+                if (active_screen_cache.follows_mouse
+                    || ev->xconfigure.window == fullscreen_cache.window
+                    || ev->xconfigure.window == active_screen_cache.toplevel)
+                        active_screen_cache.valid = false;
+                break;
+        }
+}
+
+/* see screen.h */
+void screen_active_frame_start(void)
+{
+        if (active_screen_cache.follows_mouse)
+                active_screen_cache.valid = false;
+}
+
 /* see screen.h */
 bool have_fullscreen_window(void)
 {
-        return window_is_fullscreen(get_focused_window());
+        if (!fullscreen_cache.valid) {
+                Window focused = get_focused_window();
+
+                fullscreen_track_window(focused);
+                fullscreen_cache.fullscreen = window_is_fullscreen(focused);
+                fullscreen_cache.valid = true;
+        }
+
+        return fullscreen_cache.fullscreen;
 }
 
 /**
@@ -242,12 +402,6 @@ bool window_is_fullscreen(Window window)
 
         ASSERT_OR_RET(window, false);
 
-        Atom has_wm_state = XInternAtom(xctx.dpy, "_NET_WM_STATE", True);
-        if (has_wm_state == None) {
-                return false;
-        }
-
-        XFlush(xctx.dpy);
         XSetErrorHandler(XErrorHandlerFullscreen);
 
         Atom actual_type_return;
@@ -258,7 +412,7 @@ bool window_is_fullscreen(Window window)
         int result = XGetWindowProperty(
                         xctx.dpy,
                         window,
-                        has_wm_state,
+                        xctx.atoms[ATOM_NET_WM_STATE],
                         0,                     /* long_offset */
                         sizeof(window),        /* long_length */
                         false,                 /* delete */
@@ -269,25 +423,15 @@ bool window_is_fullscreen(Window window)
                         &bytes_after_return,
                         &prop_to_return);
 
-        XFlush(xctx.dpy);
-        XSync(xctx.dpy, false);
+        // Errors arrive before the reply, no need to sync
         XSetErrorHandler(NULL);
 
-        if (result == Success) {
+        if (result == Success && actual_type_return == XA_ATOM) {
                 for(int i = 0; i < n_items; i++) {
-                        Atom atom = ((Atom*) prop_to_return)[i];
-                        if (!atom)
-                                continue;
-
-                        char *s = XGetAtomName(xctx.dpy, atom);
-                        if (!s)
-                                continue;
-
-                        if (STR_EQ(s, "_NET_WM_STATE_FULLSCREEN"))
+                        if (((Atom*) prop_to_return)[i] == xctx.atoms[ATOM_NET_WM_STATE_FULLSCREEN]) {
                                 fs = true;
-                        XFree(s);
-                        if (fs)
                                 break;
+                        }
                 }
         }
 
@@ -305,6 +449,8 @@ const struct screen_info *get_active_screen(void)
 {
         int ret = 0;
         bool force_follow_mouse = false;
+        Window focused = None;
+        Window toplevel = None;
 
         if (settings.f_mode == FOLLOW_NONE) {
                 if (settings.monitor >= 0 && settings.monitor < screens_len) {
@@ -312,6 +458,9 @@ const struct screen_info *get_active_screen(void)
                 }
                 goto sc_cleanup;
         } else {
+                if (active_screen_cache.valid && active_screen_cache.id < screens_len)
+                        return &screens[active_screen_cache.id];
+
                 int x, y;
                 assert(settings.f_mode == FOLLOW_MOUSE
                                 || settings.f_mode == FOLLOW_KEYBOARD);
@@ -322,7 +471,7 @@ const struct screen_info *get_active_screen(void)
                         RootWindow(xctx.dpy, DefaultScreen(xctx.dpy));
 
                 if (settings.f_mode == FOLLOW_KEYBOARD) {
-                        Window focused = get_focused_window();
+                        focused = get_focused_window();
 
                         if (!focused) {
                                 /*
@@ -343,6 +492,7 @@ const struct screen_info *get_active_screen(void)
                                                         xctx.dpy, focused,root,
                                                         0, 0, &x, &y,
                                                         &child_return);
+                                toplevel = get_toplevel_window(focused);
                         }
                 }
 
@@ -369,15 +519,20 @@ const struct screen_info *get_active_screen(void)
                         }
                 }
 
-                if (ret > 0)
-                        goto sc_cleanup;
+                bool errored = x_follow_tear_down_error_handler();
 
-                /* something seems to be wrong. Fall back to default */
-                ret = 0;
+                // Ask again next time, if the requests failed
+                active_screen_cache.id = ret;
+                active_screen_cache.valid = !errored;
+                active_screen_cache.follows_mouse = settings.f_mode == FOLLOW_MOUSE || force_follow_mouse;
                 goto sc_cleanup;
         }
 sc_cleanup:
-        x_follow_tear_down_error_handler();
+        // Get notified, when the focused window moves to another screen
+        if (focused)
+                fullscreen_track_window(focused);
+        active_screen_track_toplevel(toplevel);
+
         assert(screens);
         assert(ret >= 0 && ret < screens_len);
         return &screens[ret];
@@ -11,13 +11,35 @@ void init_screens(void);
 void screen_dpi_xft_cache_purge(void);
 bool screen_check_event(XEvent *ev);
 
+/**
+ * Get the screen to show the notifications on
+ *
+ * When following the keyboard or the mouse, the result is cached until
+ * screen_active_check_event() or screen_active_frame_start() find that it
+ * may have changed.
+ */
 const struct screen_info *get_active_screen(void);
+
+/**
+ * Forget the active screen, if \p ev tells the focus changed or the
+ * focused window moved.
+ */
+void screen_active_check_event(const XEvent *ev);
+
+/**
+ * Forget the active screen, if it was determined by the pointer position.
+ * Pointer motion isn't tracked, so it has to be queried for every frame.
+ */
+void screen_active_frame_start(void);
 double screen_dpi_get(const struct screen_info *scr);
 
 /**
  * Find the currently focused window and check if it's in
  * fullscreen mode
  *
+ * The result is cached until fullscreen_check_event() receives
+ * an event, which may change it.
+ *
  * @see window_is_fullscreen()
  * @see get_focused_window()
  *
@@ -26,6 +48,15 @@ double screen_dpi_get(const struct screen_info *scr);
  */
 bool have_fullscreen_window(void);
 
+/**
+ * Check if \p ev may change the result of have_fullscreen_window().
+ * Changes of the focus or of the focused window's state do.
+ *
+ * @retval true: the fullscreen state has to be checked again
+ * @retval false: otherwise
+ */
+bool fullscreen_check_event(const XEvent *ev);
+
 /**
  * Check if window is in fullscreen mode
  *
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <cairo.h>
 #include <cairo-xlib.h>
+#include <errno.h>
 #include <glib-object.h>
 #include <locale.h>
 #include <math.h>
@@ -11,8 +12,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <unistd.h>
 #include <X11/extensions/shape.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/XShm.h>
 #include <X11/Xatom.h>
 #include <X11/X.h>
 #include <X11/XKBlib.h>
@@ -35,17 +40,29 @@
 
 #include "screen.h"
 
-#define WIDTH 400
-#define HEIGHT 400
-
 struct window_x11 {
         Window xwin;
-        cairo_surface_t *root_surface;
+        cairo_surface_t *image_surface; /**< the frame draw() renders into */
+        // Only used to create the pango contexts for measuring
+        cairo_surface_t *c_surface;
         cairo_t *c_ctx;
+        Visual *visual;
+        int depth;
+        GC gc;
+        XImage *shm_image;      /**< image_surface's shared memory or NULL */
+        XShmSegmentInfo shm_info;
+        bool shm_busy;          /**< the X server may still read from shm_image */
+        Pixmap back_buffer;     /**< holds the last frame, to be copied to the window */
+        cairo_surface_t *back_buffer_surface;
+        int back_buffer_w;
+        int back_buffer_h;
         GSource *esrc;
         int cur_screen;
         bool visible;
         struct dimensions dim;
+        int shape_radius;       /**< corner radius of the window's shape (-1: unshaped) */
+        int shape_w;            /**< size of the window, when it got (un)shaped */
+        int shape_h;
 };
 
 struct x11_source {
@@ -68,6 +85,7 @@ static void x_shortcut_setup_error_handler(void);
 static int x_shortcut_tear_down_error_handler(void);
 static void setopacity(Window win, unsigned long opacity);
 static void x_handle_click(XEvent ev);
+static bool x_idle_alarm_check_event(const XSyncAlarmNotifyEvent *ev);
 
 static void x_win_move(window winptr, int x, int y, int width, int height)
 {
@@ -145,17 +163,49 @@ static void x_win_corners_unshape(window winptr)
 
 static bool x_win_composited(struct window_x11 *win)
 {
-        char astr[sizeof("_NET_WM_CM_S") / sizeof(char) + 8];
-        Atom cm_sel;
+        // XFixes tells when the compositor comes or goes
+        if (xctx.xfixes_selection_notify)
+                return xctx.composited;
 
-        sprintf(astr, "_NET_WM_CM_S%i", win->cur_screen);
-        cm_sel = XInternAtom(xctx.dpy, astr, true);
+        return XGetSelectionOwner(xctx.dpy, xctx.atoms[ATOM_NET_WM_CM]) != None;
+}
 
-        if (cm_sel == None) {
-                return false;
-        } else {
-                return XGetSelectionOwner(xctx.dpy, cm_sel) != None;
-        }
+static void x_win_back_buffer_free(struct window_x11 *win)
+{
+        if (!win->back_buffer)
+                return;
+
+        cairo_surface_destroy(win->back_buffer_surface);
+        XFreePixmap(xctx.dpy, win->back_buffer);
+
+        win->back_buffer = None;
+        win->back_buffer_surface = NULL;
+}
+
+static void x_win_back_buffer_resize(struct window_x11 *win, int width, int height)
+{
+        if (win->back_buffer && win->back_buffer_w == width && win->back_buffer_h == height)
+                return;
+
+        x_win_back_buffer_free(win);
+
+        win->back_buffer = XCreatePixmap(xctx.dpy, win->xwin, width, height, win->depth);
+        win->back_buffer_surface = cairo_xlib_surface_create(xctx.dpy, win->back_buffer,
+                                                             win->visual, width, height);
+        win->back_buffer_w = width;
+        win->back_buffer_h = height;
+}
+
+/*
+ * Copy the given area of the last frame from the back buffer to the window.
+ */
+static void x_win_present(struct window_x11 *win, int x, int y, int width, int height)
+{
+        if (!win->back_buffer)
+                return;
+
+        XCopyArea(xctx.dpy, win->back_buffer, win->xwin, win->gc,
+                  x, y, width, height, x, y);
 }
 
 void x_display_surface(cairo_surface_t *srf, window winptr, const struct dimensions *dim)
@@ -163,40 +213,194 @@ void x_display_surface(cairo_surface_t *srf, window winptr, const struct dimensi
         struct window_x11 *win = (struct window_x11*)winptr;
         const struct screen_info *scr = get_active_screen();
         double scale = x_get_scale();
+        int width = round(dim->w * scale);
+        int height = round(dim->h * scale);
         int x, y;
 
-        calc_window_pos(scr, round(dim->w * scale), round(dim->h * scale), &x, &y);
+        // Put the frame into the back buffer first, so the window never
+        // shows a partially drawn or cleared frame
+        x_win_back_buffer_resize(win, width, height);
+
+        if (srf == win->image_surface && win->shm_image) {
+                // The X server reads the frame straight from the shared memory
+                cairo_surface_flush(srf);
+                XShmPutImage(xctx.dpy, win->back_buffer, win->gc, win->shm_image,
+                             0, 0, 0, 0, width, height, true);
+                win->shm_busy = true;
+        } else {
+                cairo_t *c = cairo_create(win->back_buffer_surface);
+                cairo_set_operator(c, CAIRO_OPERATOR_SOURCE);
+                cairo_set_source_surface(c, srf, 0, 0);
+                cairo_paint(c);
+                cairo_destroy(c);
+                cairo_surface_flush(win->back_buffer_surface);
+        }
 
-        x_win_move(win, x, y, round(dim->w * scale), round(dim->h * scale));
-        cairo_xlib_surface_set_size(win->root_surface, round(dim->w * scale), round(dim->h * scale));
+        calc_window_pos(scr, width, height, &x, &y);
 
-        XClearWindow(xctx.dpy, win->xwin);
+        x_win_move(win, x, y, width, height);
 
-        cairo_set_source_surface(win->c_ctx, srf, 0, 0);
-        cairo_paint(win->c_ctx);
-        cairo_show_page(win->c_ctx);
+        x_win_present(win, 0, 0, width, height);
 
+        int shape_radius = -1;
         if (settings.corner_radius != 0 && ! x_win_composited(win))
-                x_win_corners_shape(win, round(dim->corner_radius * scale));
-        else
-                x_win_corners_unshape(win);
+                shape_radius = round(dim->corner_radius * scale);
+
+        // The shape only has to change along with the window
+        if (shape_radius != win->shape_radius
+            || win->dim.w != win->shape_w
+            || win->dim.h != win->shape_h) {
+                if (shape_radius >= 0)
+                        x_win_corners_shape(win, shape_radius);
+                else
+                        x_win_corners_unshape(win);
+
+                win->shape_radius = shape_radius;
+                win->shape_w = win->dim.w;
+                win->shape_h = win->dim.h;
+        }
 
         XFlush(xctx.dpy);
 
 }
 
+static bool x_shm_errored = false;
+
+static int x_shm_error_handler(Display *display, XErrorEvent *e)
+{
+        x_shm_errored = true;
+        return 0;
+}
+
+static void x_win_shm_free(struct window_x11 *win)
+{
+        if (!win->shm_image)
+                return;
+
+        XShmDetach(xctx.dpy, &win->shm_info);
+        shmdt(win->shm_info.shmaddr);
+
+        // The data isn't malloc'ed, so XDestroyImage must not free it
+        win->shm_image->data = NULL;
+        XDestroyImage(win->shm_image);
+
+        win->shm_image = NULL;
+        win->shm_busy = false;
+}
+
+/*
+ * Create an image in memory shared with the X server, which cairo can draw
+ * into directly. Disables MIT-SHM, if the X server can't use it.
+ *
+ * @returns the surface of the image or NULL on failure
+ */
+static cairo_surface_t *x_win_shm_create(struct window_x11 *win, int width, int height)
+{
+        XImage *image = XShmCreateImage(xctx.dpy, win->visual, win->depth, ZPixmap,
+                                        NULL, &win->shm_info, width, height);
+        if (!image)
+                return NULL;
+
+        // The pixels have to be in cairo's format to draw into them
+        int byte_order = G_BYTE_ORDER == G_LITTLE_ENDIAN ? LSBFirst : MSBFirst;
+        if (image->bits_per_pixel != 32
+            || image->byte_order != byte_order
+            || image->red_mask != 0xff0000
+            || image->green_mask != 0xff00
+            || image->blue_mask != 0xff) {
+                LOG_I("X11: Visual doesn't match cairo's format, disabling MIT-SHM");
+                XDestroyImage(image);
+                xctx.shm = false;
+                return NULL;
+        }
+
+        win->shm_info.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * height, IPC_CREAT | 0600);
+        if (win->shm_info.shmid < 0) {
+                LOG_W("X11: Cannot allocate shared memory: %s", strerror(errno));
+                XDestroyImage(image);
+                return NULL;
+        }
+
+        win->shm_info.shmaddr = shmat(win->shm_info.shmid, NULL, 0);
+        // The segment goes away, as soon as everyone detached from it
+        shmctl(win->shm_info.shmid, IPC_RMID, NULL);
+        if (win->shm_info.shmaddr == (char *)-1) {
+                LOG_W("X11: Cannot attach shared memory: %s", strerror(errno));
+                XDestroyImage(image);
+                return NULL;
+        }
+        win->shm_info.readOnly = false;
+        image->data = win->shm_info.shmaddr;
+
+        // Attaching fails for remote connections
+        x_shm_errored = false;
+        XErrorHandler old_handler = XSetErrorHandler(x_shm_error_handler);
+        XShmAttach(xctx.dpy, &win->shm_info);
+        XSync(xctx.dpy, false);
+        XSetErrorHandler(old_handler);
+
+        if (x_shm_errored) {
+                LOG_I("X11: The X server cannot attach shared memory, disabling MIT-SHM");
+                shmdt(win->shm_info.shmaddr);
+                image->data = NULL;
+                XDestroyImage(image);
+                xctx.shm = false;
+                return NULL;
+        }
+
+        win->shm_image = image;
+        return cairo_image_surface_create_for_data((unsigned char *)image->data,
+                                                   CAIRO_FORMAT_ARGB32,
+                                                   width, height,
+                                                   image->bytes_per_line);
+}
+
+cairo_surface_t* x_win_get_surface(window winptr, int width, int height)
+{
+        struct window_x11 *win = (struct window_x11*)winptr;
+
+        if (win->image_surface
+            && cairo_image_surface_get_width(win->image_surface) == width
+            && cairo_image_surface_get_height(win->image_surface) == height) {
+                // Don't draw into the image, while the X server may still
+                // be reading the last frame from it
+                if (win->shm_busy) {
+                        XSync(xctx.dpy, false);
+                        win->shm_busy = false;
+                }
+                return win->image_surface;
+        }
+
+        if (win->image_surface)
+                cairo_surface_destroy(win->image_surface);
+        x_win_shm_free(win);
+
+        win->image_surface = NULL;
+        if (xctx.shm && width > 0 && height > 0)
+                win->image_surface = x_win_shm_create(win, width, height);
+        if (!win->image_surface)
+                win->image_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+
+        return win->image_surface;
+}
+
 cairo_t* x_win_get_context(window winptr)
 {
+        // Every frame starts with fetching the context
+        screen_active_frame_start();
         return ((struct window_x11*)win)->c_ctx;
 }
 
+bool x_is_own_window(Window xwin)
+{
+        return win && ((struct window_x11*)win)->xwin == xwin;
+}
+
 static void setopacity(Window win, unsigned long opacity)
 {
-        Atom _NET_WM_WINDOW_OPACITY =
-            XInternAtom(xctx.dpy, "_NET_WM_WINDOW_OPACITY", false);
         XChangeProperty(xctx.dpy,
                         win,
-                        _NET_WM_WINDOW_OPACITY,
+                        xctx.atoms[ATOM_NET_WM_WINDOW_OPACITY],
                         XA_CARDINAL,
                         32,
                         PropModeReplace,
@@ -284,6 +488,12 @@ gboolean x_mainloop_fd_dispatch(GSource *source, GSourceFunc callback, gpointer
 {
         struct window_x11 *win = ((struct x11_source*) source)->win;
 
+        /* Drain all pending events first and only then update the window
+         * once. Otherwise a burst of events results in several redraws. */
+        bool need_wake_up = false;
+        bool need_redraw = false;
+        bool need_screen_check = false;
+
         bool fullscreen_now;
         const struct screen_info *scr;
         XEvent ev;
@@ -291,18 +501,26 @@ gboolean x_mainloop_fd_dispatch(GSource *source, GSourceFunc callback, gpointer
         while (XPending(xctx.dpy) > 0) {
                 XNextEvent(xctx.dpy, &ev);
 
+                bool fullscreen_event = fullscreen_check_event(&ev);
+                screen_active_check_event(&ev);
+
                 switch (ev.type) {
                 case Expose:
                         LOG_D("XEvent: processing 'Expose'");
-                        if (ev.xexpose.count == 0 && win->visible) {
-                                draw();
-                        }
+                        if (!win->visible)
+                                break;
+                        // The back buffer still holds the last frame
+                        if (win->back_buffer)
+                                x_win_present(win, ev.xexpose.x, ev.xexpose.y,
+                                              ev.xexpose.width, ev.xexpose.height);
+                        else
+                                need_redraw = true;
                         break;
                 case ButtonRelease:
                         LOG_D("XEvent: processing 'ButtonRelease'");
                         if (ev.xbutton.window == win->xwin) {
                                 x_handle_click(ev);
-                                wake_up();
+                                need_wake_up = true;
                         }
                         break;
                 case KeyPress:
@@ -317,7 +535,7 @@ gboolean x_mainloop_fd_dispatch(GSource *source, GSourceFunc callback, gpointer
                                 const GList *displayed = queues_get_displayed();
                                 if (displayed && displayed->data) {
                                         queues_notification_close(displayed->data, REASON_USER);
-                                        wake_up();
+                                        need_wake_up = true;
                                 }
                         }
                         if (settings.history_ks.str
@@ -325,21 +543,21 @@ gboolean x_mainloop_fd_dispatch(GSource *source, GSourceFunc callback, gpointer
                                              0) == settings.history_ks.sym
                             && settings.history_ks.mask == state) {
                                 queues_history_pop();
-                                wake_up();
+                                need_wake_up = true;
                         }
                         if (settings.close_all_ks.str
                             && XLookupKeysym(&ev.xkey,
                                              0) == settings.close_all_ks.sym
                             && settings.close_all_ks.mask == state) {
                                 queues_history_push_all();
-                                wake_up();
+                                need_wake_up = true;
                         }
                         if (settings.context_ks.str
                             && XLookupKeysym(&ev.xkey,
                                              0) == settings.context_ks.sym
                             && settings.context_ks.mask == state) {
                                 context_menu();
-                                wake_up();
+                                need_wake_up = true;
                         }
                         break;
                 case CreateNotify:
@@ -354,35 +572,38 @@ gboolean x_mainloop_fd_dispatch(GSource *source, GSourceFunc callback, gpointer
                                 XRM_update_db();
                                 screen_dpi_xft_cache_purge();
 
-                                if (win->visible) {
-                                        draw();
-                                }
+                                need_redraw = true;
                                 break;
                         }
+                        /* The properties of other windows only matter for
+                         * the fullscreen state */
+                        if (!fullscreen_event && ev.xproperty.window != DefaultRootWindow(xctx.dpy))
+                                break;
                         /* Explicitly fallthrough. Other PropertyNotify events, e.g. catching
                          * _NET_WM get handled in the Focus(In|Out) section */
                 case ConfigureNotify:
                 case FocusIn:
                 case FocusOut:
-                        LOG_D("XEvent: Checking for active screen changes");
-                        fullscreen_now = have_fullscreen_window();
-                        scr = get_active_screen();
-
-                        if (fullscreen_now != fullscreen_last) {
-                                fullscreen_last = fullscreen_now;
-                                wake_up();
-                        } else if (   settings.f_mode != FOLLOW_NONE
-                        /* Ignore PropertyNotify, when we're still on the
-                         * same screen. PropertyNotify is only necessary
-                         * to detect a focus change to another screen
-                         */
-                                   && win->visible
-                                   && scr->id != win->cur_screen) {
-                                draw();
-                                win->cur_screen = scr->id;
-                        }
+                        need_screen_check = true;
                         break;
                 default:
+                        if (xctx.shm_completion && ev.type == xctx.shm_completion) {
+                                win->shm_busy = false;
+                                break;
+                        }
+                        if (xctx.xfixes_selection_notify && ev.type == xctx.xfixes_selection_notify) {
+                                XFixesSelectionNotifyEvent *sel = (XFixesSelectionNotifyEvent*)&ev;
+                                LOG_D("XEvent: Compositor %s", sel->owner != None ? "started" : "stopped");
+                                xctx.composited = sel->owner != None;
+                                // The window has to be (un)shaped
+                                need_redraw = true;
+                                break;
+                        }
+                        if (xctx.sync_alarm_notify && ev.type == xctx.sync_alarm_notify) {
+                                if (x_idle_alarm_check_event((XSyncAlarmNotifyEvent*)&ev))
+                                        need_wake_up = true;
+                                break;
+                        }
                         if (!screen_check_event(&ev)) {
                                 LOG_D("XEvent: Ignoring '%d'", ev.type);
                         }
@@ -390,19 +611,146 @@ gboolean x_mainloop_fd_dispatch(GSource *source, GSourceFunc callback, gpointer
                         break;
                 }
         }
+
+        if (need_screen_check) {
+                LOG_D("XEvent: Checking for active screen changes");
+                fullscreen_now = have_fullscreen_window();
+                scr = get_active_screen();
+
+                if (fullscreen_now != fullscreen_last) {
+                        fullscreen_last = fullscreen_now;
+                        need_wake_up = true;
+                } else if (   settings.f_mode != FOLLOW_NONE
+                /* Ignore PropertyNotify, when we're still on the
+                 * same screen. PropertyNotify is only necessary
+                 * to detect a focus change to another screen
+                 */
+                           && win->visible
+                           && scr->id != win->cur_screen) {
+                        need_redraw = true;
+                        win->cur_screen = scr->id;
+                }
+        }
+
+        // Waking up draws the notifications anyways
+        if (need_wake_up)
+                wake_up();
+        else if (need_redraw && win->visible)
+                draw();
+
         return G_SOURCE_CONTINUE;
 }
 
+static void x_idle_value(XSyncValue *value, gint64 ms)
+{
+        XSyncIntsToValue(value, (unsigned int)(ms & 0xffffffff), (int)(ms >> 32));
+}
+
+/*
+ * Set the idle state and let the alarm fire, when it changes again.
+ */
+static void x_idle_alarm_set(bool idle)
+{
+        gint64 threshold = settings.idle_threshold / 1000;
+        XSyncAlarmAttributes attr;
+
+        attr.trigger.counter = xctx.idle_counter;
+        attr.trigger.value_type = XSyncAbsolute;
+        if (idle) {
+                // Fires right away, if the user got active again meanwhile
+                attr.trigger.test_type = XSyncNegativeComparison;
+                x_idle_value(&attr.trigger.wait_value, threshold);
+        } else {
+                attr.trigger.test_type = XSyncPositiveComparison;
+                x_idle_value(&attr.trigger.wait_value, threshold + 1);
+        }
+        XSyncIntToValue(&attr.delta, 0);
+        attr.events = true;
+
+        unsigned long mask = XSyncCACounter | XSyncCAValueType | XSyncCATestType
+                           | XSyncCAValue | XSyncCADelta | XSyncCAEvents;
+        if (xctx.idle_alarm)
+                XSyncChangeAlarm(xctx.dpy, xctx.idle_alarm, mask, &attr);
+        else
+                xctx.idle_alarm = XSyncCreateAlarm(xctx.dpy, mask, &attr);
+
+        xctx.idle = idle;
+        xctx.idle_alarm_threshold = settings.idle_threshold;
+}
+
+/*
+ * Update the idle state, when the idle alarm fired.
+ *
+ * @retval true: the idle state changed
+ */
+static bool x_idle_alarm_check_event(const XSyncAlarmNotifyEvent *ev)
+{
+        if (ev->alarm != xctx.idle_alarm || ev->state == XSyncAlarmDestroyed)
+                return false;
+
+        XSyncValue threshold;
+        x_idle_value(&threshold, settings.idle_threshold / 1000);
+        bool idle = XSyncValueGreaterThan(ev->counter_value, threshold);
+
+        LOG_D("X11: Idle alarm, user is %s", idle ? "idle" : "active");
+        bool changed = idle != xctx.idle;
+        x_idle_alarm_set(idle);
+        return changed;
+}
+
+/*
+ * Look up the IDLETIME counter of the SYNC extension, to get notified
+ * about the user getting idle instead of polling the idle time.
+ */
+static void x_idle_init(void)
+{
+        int event_base, error_base, major, minor;
+
+        xctx.idle_counter = None;
+        xctx.idle_alarm = None;
+        xctx.sync_alarm_notify = 0;
+
+        if (!XSyncQueryExtension(xctx.dpy, &event_base, &error_base)
+            || !XSyncInitialize(xctx.dpy, &major, &minor)) {
+                LOG_I("X11: SYNC extension not available, polling the idle time");
+                return;
+        }
+
+        int n = 0;
+        XSyncSystemCounter *counters = XSyncListSystemCounters(xctx.dpy, &n);
+        for (int i = 0; i < n; i++) {
+                if (STR_EQ(counters[i].name, "IDLETIME"))
+                        xctx.idle_counter = counters[i].counter;
+        }
+        if (counters)
+                XSyncFreeSystemCounterList(counters);
+
+        if (!xctx.idle_counter) {
+                LOG_I("X11: No IDLETIME counter, polling the idle time");
+                return;
+        }
+
+        xctx.sync_alarm_notify = event_base + XSyncAlarmNotify;
+}
+
 /*
  * Check whether the user is currently idle.
  */
 bool x_is_idle(void)
 {
-        XScreenSaverQueryInfo(xctx.dpy, DefaultRootWindow(xctx.dpy),
-                              xctx.screensaver_info);
         if (settings.idle_threshold == 0) {
                 return false;
         }
+
+        if (xctx.idle_counter) {
+                // The alarm fires right away, if the user is idle already
+                if (!xctx.idle_alarm || xctx.idle_alarm_threshold != settings.idle_threshold)
+                        x_idle_alarm_set(false);
+                return xctx.idle;
+        }
+
+        XScreenSaverQueryInfo(xctx.dpy, DefaultRootWindow(xctx.dpy),
+                              xctx.screensaver_info);
         return xctx.screensaver_info->idle > settings.idle_threshold / 1000;
 }
 
@@ -456,6 +804,10 @@ void x_free(void)
         if (xctx.screensaver_info)
                 XFree(xctx.screensaver_info);
 
+        if (xctx.idle_alarm)
+                XSyncDestroyAlarm(xctx.dpy, xctx.idle_alarm);
+        xctx.idle_alarm = None;
+
         if (xctx.dpy)
                 XCloseDisplay(xctx.dpy);
 }
@@ -501,6 +853,55 @@ static void XRM_update_db(void)
         XSetErrorHandler(NULL);
 }
 
+/*
+ * Intern all atoms dunst uses in a single round trip.
+ */
+static void x_atoms_init(void)
+{
+        char *names[ATOM_COUNT] = {
+                [ATOM_UTF8_STRING]                      = "UTF8_STRING",
+                [ATOM_NET_ACTIVE_WINDOW]                = "_NET_ACTIVE_WINDOW",
+                [ATOM_NET_WM_NAME]                      = "_NET_WM_NAME",
+                [ATOM_NET_WM_STATE]                     = "_NET_WM_STATE",
+                [ATOM_NET_WM_STATE_ABOVE]               = "_NET_WM_STATE_ABOVE",
+                [ATOM_NET_WM_STATE_FULLSCREEN]          = "_NET_WM_STATE_FULLSCREEN",
+                [ATOM_NET_WM_WINDOW_OPACITY]            = "_NET_WM_WINDOW_OPACITY",
+                [ATOM_NET_WM_WINDOW_TYPE]               = "_NET_WM_WINDOW_TYPE",
+                [ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION]  = "_NET_WM_WINDOW_TYPE_NOTIFICATION",
+                [ATOM_NET_WM_WINDOW_TYPE_UTILITY]       = "_NET_WM_WINDOW_TYPE_UTILITY",
+        };
+
+        // The compositor manager selection is per X screen
+        names[ATOM_NET_WM_CM] = g_strdup_printf("_NET_WM_CM_S%i", DefaultScreen(xctx.dpy));
+
+        XInternAtoms(xctx.dpy, names, ATOM_COUNT, false, xctx.atoms);
+
+        g_free(names[ATOM_NET_WM_CM]);
+}
+
+/*
+ * Watch the compositor manager selection with XFixes, so there's no need
+ * to ask for its owner for every frame.
+ */
+static void x_compositor_init(void)
+{
+        int event_base, error_base;
+
+        xctx.xfixes_selection_notify = 0;
+        if (!XFixesQueryExtension(xctx.dpy, &event_base, &error_base)) {
+                LOG_I("X11: XFixes not available, polling for a compositor");
+                return;
+        }
+
+        XFixesSelectSelectionInput(xctx.dpy, DefaultRootWindow(xctx.dpy), xctx.atoms[ATOM_NET_WM_CM],
+                                   XFixesSetSelectionOwnerNotifyMask
+                                   | XFixesSelectionWindowDestroyNotifyMask
+                                   | XFixesSelectionClientCloseNotifyMask);
+
+        xctx.xfixes_selection_notify = event_base + XFixesSelectionNotify;
+        xctx.composited = XGetSelectionOwner(xctx.dpy, xctx.atoms[ATOM_NET_WM_CM]) != None;
+}
+
 /*
  * Setup X11 stuff
  */
@@ -531,10 +932,20 @@ bool x_setup(void)
         x_shortcut_ungrab(&settings.context_ks);
 
         xctx.screensaver_info = XScreenSaverAllocInfo();
+        x_idle_init();
+
+        xctx.shm = XShmQueryExtension(xctx.dpy);
+        if (xctx.shm)
+                xctx.shm_completion = XShmGetEventBase(xctx.dpy) + ShmCompletion;
+        else
+                LOG_I("X11: MIT-SHM not available, sending frames over the connection");
 
         XrmInitialize();
         XRM_update_db();
 
+        x_atoms_init();
+        x_compositor_init();
+
         init_screens();
         x_shortcut_grab(&settings.history_ks);
         return true;
@@ -547,14 +958,12 @@ static void x_set_wm(Window win)
 
         /* set window title */
         char *title = settings.title != NULL ? settings.title : "Dunst";
-        Atom _net_wm_title =
-                XInternAtom(xctx.dpy, "_NET_WM_NAME", false);
 
         XStoreName(xctx.dpy, win, title);
         XChangeProperty(xctx.dpy,
                         win,
-                        _net_wm_title,
-                        XInternAtom(xctx.dpy, "UTF8_STRING", false),
+                        xctx.atoms[ATOM_NET_WM_NAME],
+                        xctx.atoms[ATOM_UTF8_STRING],
                         8,
                         PropModeReplace,
                         (unsigned char *)title,
@@ -567,15 +976,12 @@ static void x_set_wm(Window win)
         XSetClassHint(xctx.dpy, win, &classhint);
 
         /* set window type */
-        Atom net_wm_window_type =
-                XInternAtom(xctx.dpy, "_NET_WM_WINDOW_TYPE", false);
-
-        data[0] = XInternAtom(xctx.dpy, "_NET_WM_WINDOW_TYPE_NOTIFICATION", false);
-        data[1] = XInternAtom(xctx.dpy, "_NET_WM_WINDOW_TYPE_UTILITY", false);
+        data[0] = xctx.atoms[ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION];
+        data[1] = xctx.atoms[ATOM_NET_WM_WINDOW_TYPE_UTILITY];
 
         XChangeProperty(xctx.dpy,
                         win,
-                        net_wm_window_type,
+                        xctx.atoms[ATOM_NET_WM_WINDOW_TYPE],
                         XA_ATOM,
                         32,
                         PropModeReplace,
@@ -583,12 +989,9 @@ static void x_set_wm(Window win)
                         2L);
 
         /* set state above */
-        Atom net_wm_state =
-                XInternAtom(xctx.dpy, "_NET_WM_STATE", false);
-
-        data[0] = XInternAtom(xctx.dpy, "_NET_WM_STATE_ABOVE", false);
+        data[0] = xctx.atoms[ATOM_NET_WM_STATE_ABOVE];
 
-        XChangeProperty(xctx.dpy, win, net_wm_state, XA_ATOM, 32,
+        XChangeProperty(xctx.dpy, win, xctx.atoms[ATOM_NET_WM_STATE], XA_ATOM, 32,
                 PropModeReplace, (unsigned char *) data, 1L);
 }
 
@@ -664,6 +1067,12 @@ window x_win_create(void)
                                  CWOverrideRedirect | CWBackPixmap | CWBackPixel | CWBorderPixel | CWColormap | CWEventMask,
                                  &wa);
 
+        win->visual = vis;
+        win->depth = depth;
+        win->gc = XCreateGC(xctx.dpy, win->xwin, 0, NULL);
+        // A new window isn't shaped yet
+        win->shape_radius = -1;
+
         x_set_wm(win->xwin);
         settings.transparency =
             settings.transparency > 100 ? 100 : settings.transparency;
@@ -671,10 +1080,9 @@ window x_win_create(void)
                    (unsigned long)((100 - settings.transparency) *
                                    (0xffffffff / 100)));
 
-        win->root_surface = cairo_xlib_surface_create(xctx.dpy, win->xwin,
-                                                      vis,
-                                                      WIDTH, HEIGHT);
-        win->c_ctx = cairo_create(win->root_surface);
+        // Frames get rendered into an image surface, measure with the same kind
+        win->c_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+        win->c_ctx = cairo_create(win->c_surface);
 
         win->esrc = x_win_reg_source(win);
 
@@ -685,11 +1093,12 @@ window x_win_create(void)
          *                    and it's also needed to receive
          *                    XA_RESOURCE_MANAGER events to update the dpi when
          *                    the xresource value is updated
+         *
+         * FocusChangeMask is required for getting screen change events when follow_mode != none
+         *                 and to notice the focus moving away from the root window,
+         *                 which changes the fullscreen state
          */
-        long root_event_mask = SubstructureNotifyMask | PropertyChangeMask;
-        if (settings.f_mode != FOLLOW_NONE) {
-                root_event_mask |= FocusChangeMask;
-        }
+        long root_event_mask = SubstructureNotifyMask | PropertyChangeMask | FocusChangeMask;
         XSelectInput(xctx.dpy, root, root_event_mask);
 
         return (window)win;
@@ -703,7 +1112,12 @@ void x_win_destroy(window winptr)
         g_source_unref(win->esrc);
 
         cairo_destroy(win->c_ctx);
-        cairo_surface_destroy(win->root_surface);
+        cairo_surface_destroy(win->c_surface);
+        if (win->image_surface)
+                cairo_surface_destroy(win->image_surface);
+        x_win_shm_free(win);
+        x_win_back_buffer_free(win);
+        XFreeGC(xctx.dpy, win->gc);
         XDestroyWindow(xctx.dpy, win->xwin);
 
         g_free(win);
@@ -743,7 +1157,8 @@ void x_win_show(window winptr)
         XMapRaised(xctx.dpy, win->xwin);
         win->visible = true;
 
-        x_display_surface(win->root_surface, win, &win->dim);
+        x_win_present(win, 0, 0, win->back_buffer_w, win->back_buffer_h);
+        XFlush(xctx.dpy);
 }
 
 /*
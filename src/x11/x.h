@@ -8,6 +8,7 @@
 #include <glib.h>
 #include <stdbool.h>
 #include <X11/extensions/scrnsaver.h>
+#include <X11/extensions/sync.h>
 #include <X11/X.h>
 #include <X11/Xlib.h>
 
@@ -26,9 +27,37 @@ struct keyboard_shortcut {
 // Cyclical dependency
 #include "../settings.h"
 
+/**
+ * The atoms dunst uses, interned once in x_setup()
+ */
+enum x_atom {
+        ATOM_UTF8_STRING,
+        ATOM_NET_ACTIVE_WINDOW,
+        ATOM_NET_WM_NAME,
+        ATOM_NET_WM_STATE,
+        ATOM_NET_WM_STATE_ABOVE,
+        ATOM_NET_WM_STATE_FULLSCREEN,
+        ATOM_NET_WM_WINDOW_OPACITY,
+        ATOM_NET_WM_WINDOW_TYPE,
+        ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION,
+        ATOM_NET_WM_WINDOW_TYPE_UTILITY,
+        ATOM_NET_WM_CM,         /**< _NET_WM_CM_S<n> of the default screen */
+        ATOM_COUNT,
+};
+
 struct x_context {
         Display *dpy;
+        Atom atoms[ATOM_COUNT];
         XScreenSaverInfo *screensaver_info;
+        bool shm;               /**< frames can be shared via MIT-SHM */
+        int shm_completion;     /**< event type of ShmCompletion (0: none) */
+        XSyncCounter idle_counter;      /**< the IDLETIME counter (None: poll the idle time) */
+        XSyncAlarm idle_alarm;          /**< fires, when the user gets idle or active again */
+        gint64 idle_alarm_threshold;    /**< idle_threshold the alarm got set up for */
+        int sync_alarm_notify;          /**< event type of XSyncAlarmNotify */
+        bool idle;                      /**< the idle state according to the alarm */
+        int xfixes_selection_notify;    /**< event type of XFixesSelectionNotify (0: none) */
+        bool composited;                /**< a compositor owns _NET_WM_CM_S<n> */
 };
 
 extern struct x_context xctx;
@@ -41,9 +70,15 @@ void x_win_show(window);
 void x_win_hide(window);
 
 void x_display_surface(cairo_surface_t *srf, window, const struct dimensions *dim);
+cairo_surface_t* x_win_get_surface(window, int width, int height);
 
 cairo_t* x_win_get_context(window);
 
+/**
+ * @retval true: \p xwin is a window of dunst
+ */
+bool x_is_own_window(Window xwin);
+
 /* X misc */
 bool x_is_idle(void);
 bool x_setup(void);
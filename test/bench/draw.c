@@ -0,0 +1,287 @@
+/* Rendering benchmark for draw.c
+ *
+ * Drives draw() through the headless output over a matrix of scenarios and
+ * reports the frame latency percentiles and the allocations per frame.
+ *
+ * Usage: test/bench/draw [FRAMES]
+ */
+#include "../../src/draw.c"
+
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers.h"
+#include "../../src/headless/headless.h"
+#include "../../src/log.h"
+#include "../../src/settings.h"
+
+#define DEFAULT_FRAMES 30
+
+static char *base;
+
+#ifdef __GLIBC__
+/* Count the allocations by wrapping the allocator of glibc. glib, pango and
+ * cairo all end up calling these. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocations = 0;
+
+void *malloc(size_t size)
+{
+        __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+        return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+        __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+        return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+        __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+        return __libc_realloc(ptr, size);
+}
+
+static unsigned long allocations_get(void)
+{
+        return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
+#else
+static unsigned long allocations_get(void)
+{
+        return 0;
+}
+#endif
+
+struct scenario {
+        int count;
+        bool markup_heavy;
+        bool icons;
+        bool progress;
+        bool gaps;
+        int corner_radius;
+        double scale;
+};
+
+struct result {
+        gint64 p50;
+        gint64 p90;
+        gint64 p99;
+        gint64 max;
+        double allocations;     /**< per frame */
+};
+
+static const char *body_light = "The quick brown fox jumps over the lazy dog.";
+static const char *body_heavy =
+        "<b>The quick</b> <i>brown fox</i> <u>jumps</u> over "
+        "<span foreground='#ff0000'>the lazy dog</span>. "
+        "<b><i>Pack my box</i></b> with <s>five</s> <tt>dozen</tt> "
+        "<span size='small' weight='bold'>liquor jugs</span>.";
+
+static void scenario_setup(const struct scenario *s)
+{
+        settings.scale = s->scale;
+        settings.corner_radius = s->corner_radius;
+        settings.gap_size = s->gaps ? 5 : 0;
+        settings.progress_bar = s->progress;
+        settings.notification_limit = 0;
+
+        char *icon = g_strconcat(base, "/../data/icons/valid.png", NULL);
+
+        queues_init();
+        for (int i = 0; i < s->count; i++) {
+                char name[16];
+                snprintf(name, sizeof(name), "bench %d", i);
+
+                struct notification *n = test_notification_uninitialized(name);
+                g_free(n->body);
+                n->body = g_strdup(s->markup_heavy ? body_heavy : body_light);
+                n->markup = s->markup_heavy ? MARKUP_FULL : MARKUP_NO;
+                n->progress = s->progress ? i % 100 : -1;
+                notification_init(n);
+
+                n->icon_position = s->icons ? ICON_LEFT : ICON_OFF;
+                if (s->icons)
+                        notification_icon_replace_path(n, icon);
+
+                queues_notification_insert(n);
+        }
+        queues_update((struct dunst_status) { .running = true }, time_monotonic_now());
+
+        g_free(icon);
+}
+
+static void scenario_teardown(void)
+{
+        last_frame_clear();
+        queues_teardown();
+}
+
+static int cmp_gint64(const void *a, const void *b)
+{
+        gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+        return (x > y) - (x < y);
+}
+
+static struct result result_from(gint64 *durations, int frames, unsigned long allocs)
+{
+        qsort(durations, frames, sizeof(*durations), cmp_gint64);
+
+        struct result r;
+        r.p50 = durations[frames * 50 / 100];
+        r.p90 = durations[frames * 90 / 100];
+        r.p99 = durations[frames * 99 / 100];
+        r.max = durations[frames - 1];
+        r.allocations = (double)allocs / frames;
+        return r;
+}
+
+/**
+ * Render \p frames frames from scratch, as if the notifications changed
+ * completely between every frame.
+ */
+static struct result bench_full(int frames)
+{
+        gint64 *durations = g_malloc(frames * sizeof(gint64));
+        unsigned long allocs = 0;
+
+        for (int i = 0; i < frames; i++) {
+                last_frame_clear();
+
+                unsigned long allocs_start = allocations_get();
+                gint64 start = time_monotonic_now();
+                draw();
+                durations[i] = time_monotonic_now() - start;
+                allocs += allocations_get() - allocs_start;
+        }
+
+        struct result r = result_from(durations, frames, allocs);
+        g_free(durations);
+        return r;
+}
+
+/**
+ * Render \p frames frames, where only the progress of the notifications
+ * changes between the frames.
+ */
+static struct result bench_progress(int frames)
+{
+        gint64 *durations = g_malloc(frames * sizeof(gint64));
+        unsigned long allocs = 0;
+
+        // The first frame sets up the layouts to update later on
+        draw();
+
+        for (int i = 0; i < frames; i++) {
+                for (const GList *iter = queues_get_displayed(); iter; iter = iter->next) {
+                        struct notification *n = iter->data;
+                        if (n->progress >= 0)
+                                n->progress = (n->progress + 1) % 100;
+                }
+
+                unsigned long allocs_start = allocations_get();
+                gint64 start = time_monotonic_now();
+                draw();
+                durations[i] = time_monotonic_now() - start;
+                allocs += allocations_get() - allocs_start;
+        }
+
+        struct result r = result_from(durations, frames, allocs);
+        g_free(durations);
+        return r;
+}
+
+static void print_result(const char *kind, const struct scenario *s, const struct result *r)
+{
+        printf("%-8s %5d %-6s %-5s %-8s %-10s %6d %5.1f   %8" G_GINT64_FORMAT
+               " %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT " %10.1f\n",
+               kind,
+               s->count,
+               s->markup_heavy ? "heavy" : "light",
+               s->icons ? "icon" : "-",
+               s->progress ? "progress" : "-",
+               s->gaps ? "gaps" : "separators",
+               s->corner_radius,
+               s->scale,
+               r->p50, r->p90, r->p99, r->max,
+               r->allocations);
+}
+
+int main(int argc, char *argv[])
+{
+        int frames = DEFAULT_FRAMES;
+        if (argc > 1 && (!safe_string_to_int(&frames, argv[1]) || frames <= 0)) {
+                fprintf(stderr, "Usage: %s [FRAMES]\n", argv[0]);
+                return 1;
+        }
+
+        char *prog = realpath(argv[0], NULL);
+        if (!prog) {
+                fprintf(stderr, "Cannot determine actual path of benchmark executable: %s\n", strerror(errno));
+                return 1;
+        }
+        base = dirname(prog);
+
+        dunst_log_init(true);
+
+        char *config_path = g_strconcat(base, "/../data/dunstrc.default", NULL);
+        load_settings(config_path);
+
+        g_setenv("DUNST_HEADLESS", "1", true);
+        g_setenv("DUNST_HEADLESS_SCREEN", "3840x2160", true);
+        g_unsetenv("DUNST_HEADLESS_SCALE");
+        output = output_create(false);
+        win = output->win_create();
+
+        printf("%d frames per scenario, times in microseconds\n\n", frames);
+        printf("%-8s %5s %-6s %-5s %-8s %-10s %6s %5s   %8s %8s %8s %8s %10s\n",
+               "kind", "count", "markup", "icons", "progress", "layout", "radius", "scale",
+               "p50", "p90", "p99", "max", "allocs");
+
+        const int counts[] = { 1, 10, 100 };
+        const int radii[] = { 0, 10 };
+        const double scales[] = { 1, 2 };
+
+        for (int c = 0; c < G_N_ELEMENTS(counts); c++)
+        for (int markup = 0; markup < 2; markup++)
+        for (int icons = 0; icons < 2; icons++)
+        for (int progress = 0; progress < 2; progress++)
+        for (int gaps = 0; gaps < 2; gaps++)
+        for (int r = 0; r < G_N_ELEMENTS(radii); r++)
+        for (int sc = 0; sc < G_N_ELEMENTS(scales); sc++) {
+                struct scenario s = {
+                        .count = counts[c],
+                        .markup_heavy = markup,
+                        .icons = icons,
+                        .progress = progress,
+                        .gaps = gaps,
+                        .corner_radius = radii[r],
+                        .scale = scales[sc],
+                };
+                struct result res;
+
+                scenario_setup(&s);
+                res = bench_full(frames);
+                print_result("full", &s, &res);
+                if (s.progress) {
+                        res = bench_progress(frames);
+                        print_result("progress", &s, &res);
+                }
+                scenario_teardown();
+        }
+
+        output->win_destroy(win);
+        output->deinit();
+        g_free(config_path);
+        free(prog);
+
+        return 0;
+}
+/* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -270,10 +270,9 @@ void dbus_notification_free(struct dbus_notification *n)
         g_free(n);
 }
 
-bool dbus_notification_fire(struct dbus_notification *n, uint *id)
+GVariant *dbus_notification_params(struct dbus_notification *n)
 {
         assert(n);
-        assert(id);
         GVariantBuilder b;
         GVariantType *t;
 
@@ -317,7 +316,15 @@ bool dbus_notification_fire(struct dbus_notification *n, uint *id)
 
         g_variant_builder_add(&b, "i", n->expire_timeout);
 
-        GVariant *reply = dbus_invoke("Notify", g_variant_builder_end(&b));
+        return g_variant_builder_end(&b);
+}
+
+bool dbus_notification_fire(struct dbus_notification *n, uint *id)
+{
+        assert(n);
+        assert(id);
+
+        GVariant *reply = dbus_invoke("Notify", dbus_notification_params(n));
         if (reply) {
                 g_variant_get(reply, "(u)", id);
                 g_variant_unref(reply);
@@ -363,14 +370,218 @@ TEST test_dbus_teardown(void)
 TEST test_invalid_notification(void)
 {
         GVariant *faulty = g_variant_new_boolean(true);
+        GVariant *hints, *icon_value;
 
-        ASSERT(NULL == dbus_message_to_notification(":123", faulty));
+        ASSERT(NULL == dbus_message_decode(":123", faulty, &hints, &icon_value));
         ASSERT(NULL == dbus_invoke("Notify", faulty));
 
         g_variant_unref(faulty);
         PASS();
 }
 
+TEST test_ingest_list_keeps_order(void)
+{
+        struct ingest_job jobs[3];
+        struct ingest_job *head = NULL;
+
+        ASSERT(NULL == ingest_list_take(&head));
+
+        for (int i = 0; i < 3; i++)
+                ingest_list_push(&head, &jobs[i]);
+
+        struct ingest_job *job = ingest_list_take(&head);
+        ASSERT(NULL == head);
+        ASSERT_EQ(&jobs[0], job);
+        ASSERT_EQ(&jobs[1], job->next);
+        ASSERT_EQ(&jobs[2], job->next->next);
+        ASSERT(NULL == job->next->next->next);
+
+        PASS();
+}
+
+TEST test_notify_inserts_in_order(void)
+{
+        struct dbus_notification *n_dbus = dbus_notification_new();
+        n_dbus->app_name = "dunstteststack";
+        n_dbus->app_icon = "NONE";
+        n_dbus->body = "Text";
+
+        gsize len = queues_length_waiting();
+
+        guint ids[3];
+        for (int i = 0; i < G_N_ELEMENTS(ids); i++) {
+                char *summary = g_strdup_printf("Ingest %d", i);
+                n_dbus->summary = summary;
+                ASSERT(dbus_notification_fire(n_dbus, &ids[i]));
+                g_free(summary);
+        }
+
+        // The reply only comes after the notification got inserted
+        ASSERT_EQ(queues_length_waiting(), len + G_N_ELEMENTS(ids));
+        for (int i = 0; i < G_N_ELEMENTS(ids); i++) {
+                struct notification *n = queues_get_by_id(ids[i]);
+                ASSERT(n);
+                ASSERT(n->msg);
+                if (i > 0)
+                        ASSERT(ids[i - 1] < ids[i]);
+        }
+
+        dbus_notification_free(n_dbus);
+        PASS();
+}
+
+struct notify_result {
+        bool done;
+        GError *error;
+};
+
+static void notify_reply_cb(GObject *source, GAsyncResult *res, gpointer data)
+{
+        struct notify_result *result = data;
+        GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &result->error);
+        if (reply)
+                g_variant_unref(reply);
+        result->done = true;
+}
+
+static gint ingest_held = 0;
+
+static void ingest_worker_holding(gpointer data, gpointer user_data)
+{
+        while (g_atomic_int_get(&ingest_held))
+                g_usleep(100);
+
+        ingest_worker(data, user_data);
+}
+
+TEST test_close_waits_for_notify(void)
+{
+        struct dbus_notification *n_dbus = dbus_notification_new();
+        n_dbus->app_name = "dunstteststack";
+        n_dbus->app_icon = "NONE";
+        n_dbus->summary = "Original";
+        n_dbus->body = "Text";
+
+        guint id;
+        ASSERT(dbus_notification_fire(n_dbus, &id));
+        gsize len = queues_length_waiting();
+
+        g_atomic_int_set(&ingest_held, 1);
+        GThreadPool *pool = ingest->pool;
+        ingest->pool = g_thread_pool_new(ingest_worker_holding, NULL, 1, FALSE, NULL);
+        g_thread_pool_free(pool, FALSE, TRUE);
+
+        GMainContext *context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+        GDBusConnection *client = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+
+        // Replace the notification and close it right after
+        n_dbus->replaces_id = id;
+        n_dbus->summary = "Replaced";
+        struct notify_result notified = { false, NULL };
+        g_dbus_connection_call(client, FDN_NAME, FDN_PATH, FDN_IFAC, "Notify",
+                               dbus_notification_params(n_dbus),
+                               G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE,
+                               -1, NULL, notify_reply_cb, &notified);
+
+        struct notify_result closed = { false, NULL };
+        g_dbus_connection_call(client, FDN_NAME, FDN_PATH, FDN_IFAC, "CloseNotification",
+                               g_variant_new("(u)", id),
+                               NULL, G_DBUS_CALL_FLAGS_NONE,
+                               -1, NULL, notify_reply_cb, &closed);
+
+        uint waiting = 0;
+        while (g_queue_get_length(&ingest->calls) < 2 && waiting < 2000) {
+                usleep(500);
+                waiting++;
+        }
+        ASSERT_EQ(g_queue_get_length(&ingest->calls), 2);
+        ASSERT_EQ(queues_length_waiting(), len);
+
+        g_atomic_int_set(&ingest_held, 0);
+        while (!notified.done || !closed.done)
+                g_main_context_iteration(context, true);
+
+        ASSERT(!notified.error);
+        ASSERT(!closed.error);
+
+        // The close applied to the replacement, which is in the history now
+        struct notification *n = queues_get_by_id(id);
+        ASSERT(n);
+        ASSERT_STR_EQ("Replaced", n->summary);
+        ASSERT_EQ(queues_length_waiting(), len - 1);
+
+        pool = ingest->pool;
+        ingest->pool = g_thread_pool_new(ingest_worker, NULL, 1, FALSE, NULL);
+        g_thread_pool_free(pool, FALSE, TRUE);
+
+        g_object_unref(client);
+        g_main_context_pop_thread_default(context);
+        g_main_context_unref(context);
+        dbus_notification_free(n_dbus);
+        PASS();
+}
+
+static gint ingest_stalled = 0;
+
+static void ingest_worker_stalling(gpointer data, gpointer user_data)
+{
+        g_atomic_int_set(&ingest_stalled, 1);
+
+        // Hold the notification back until the shutdown began
+        while (!g_source_is_destroyed(&ingest->source))
+                g_usleep(100);
+
+        ingest_worker(data, user_data);
+}
+
+TEST test_dbus_teardown_rejects_pending(void)
+{
+        GThreadPool *pool = ingest->pool;
+        ingest->pool = g_thread_pool_new(ingest_worker_stalling, NULL, 1, FALSE, NULL);
+        g_thread_pool_free(pool, FALSE, TRUE);
+
+        GMainContext *context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+        GDBusConnection *client = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+
+        struct dbus_notification *n_dbus = dbus_notification_new();
+        n_dbus->app_name = "dunstteststack";
+        n_dbus->app_icon = "NONE";
+        n_dbus->summary = "Too late";
+        n_dbus->body = "Text";
+
+        gsize len = queues_length_waiting();
+
+        struct notify_result result = { false, NULL };
+        g_dbus_connection_call(client, FDN_NAME, FDN_PATH, FDN_IFAC, "Notify",
+                               dbus_notification_params(n_dbus),
+                               G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE,
+                               -1, NULL, notify_reply_cb, &result);
+
+        while (!g_atomic_int_get(&ingest_stalled))
+                g_usleep(100);
+
+        dbus_teardown(owner_id);
+
+        while (!result.done)
+                g_main_context_iteration(context, true);
+
+        ASSERT(result.error);
+        ASSERT(g_str_has_suffix(result.error->message, "shutting down"));
+        ASSERT_EQ(queues_length_waiting(), len);
+
+        g_error_free(result.error);
+        g_object_unref(client);
+        g_main_context_pop_thread_default(context);
+        g_main_context_unref(context);
+        dbus_notification_free(n_dbus);
+
+        // Bring the daemon back for the following tests
+        CHECK_CALL(test_dbus_init);
+        PASS();
+}
+
 TEST test_dbus_cb_dunst_Properties_Get(void)
 {
 
@@ -1129,6 +1340,9 @@ gpointer run_threaded_tests(gpointer data)
         RUN_TEST(test_empty_notification);
         RUN_TEST(test_basic_notification);
         RUN_TEST(test_invalid_notification);
+        RUN_TEST(test_ingest_list_keeps_order);
+        RUN_TEST(test_notify_inserts_in_order);
+        RUN_TEST(test_close_waits_for_notify);
         RUN_TEST(test_hint_transient);
         RUN_TEST(test_hint_progress);
         RUN_TEST(test_hint_icons);
@@ -1150,6 +1364,7 @@ gpointer run_threaded_tests(gpointer data)
 
         RUN_TEST(assert_methodlists_sorted);
 
+        RUN_TEST(test_dbus_teardown_rejects_pending);
         RUN_TEST(test_dbus_teardown);
         g_main_loop_quit(loop);
         return NULL;
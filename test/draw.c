@@ -1,6 +1,8 @@
 #include "../src/draw.c"
 #include "greatest.h"
 #include "helpers.h"
+#include "queues.h"
+#include "../src/headless/headless.h"
 #include <cairo.h>
 
 cairo_t *c;
@@ -12,6 +14,11 @@ const struct screen_info* noop_screen(void) {
         return &i;
 }
 
+const struct screen_info* wide_screen(void) {
+        static struct screen_info i = { .w = 1920, .h = 1080 };
+        return &i;
+}
+
 const struct output dummy_output = {
         x_setup,
         x_free,
@@ -23,6 +30,7 @@ const struct output dummy_output = {
         x_win_hide,
 
         x_display_surface,
+        x_win_get_surface,
         x_win_get_context,
 
         noop_screen,
@@ -93,6 +101,7 @@ TEST test_layout_from_notification(void)
         struct notification *n = test_notification_with_icon("test", 10);
         n->icon_position = ICON_LEFT;
         ASSERT(n->icon);
+        g_free(n->text_to_render);
         n->text_to_render = g_strdup("");
         struct colored_layout *cl = layout_from_notification(c, n);
         ASSERT(cl->icon);
@@ -106,6 +115,7 @@ TEST test_layout_from_notification_icon_off(void)
         struct notification *n = test_notification_with_icon("test", 10);
         n->icon_position = ICON_OFF;
         ASSERT(n->icon);
+        g_free(n->text_to_render);
         n->text_to_render = g_strdup("");
         struct colored_layout *cl = layout_from_notification(c, n);
         ASSERT_FALSE(cl->icon);
@@ -119,6 +129,7 @@ TEST test_layout_from_notification_no_icon(void)
         struct notification *n = test_notification("test", 10);
         n->icon_position = ICON_LEFT;
         ASSERT_FALSE(n->icon);
+        g_free(n->text_to_render);
         n->text_to_render = g_strdup("");
         struct colored_layout *cl = layout_from_notification(c, n);
         ASSERT_FALSE(cl->icon);
@@ -301,6 +312,315 @@ TEST test_layout_render_gaps(void)
         PASS();
 }
 
+TEST test_layout_render_reuses_measured_layout(void)
+{
+        struct length original_width = settings.width;
+        int original_height = settings.height;
+        settings.width.min = 300;
+        settings.width.max = 300;
+        settings.height = get_small_max_height();
+
+        struct output wide_output = dummy_output;
+        wide_output.get_active_screen = wide_screen;
+        output = &wide_output;
+
+        GSList *notifications = get_dummy_notifications(1);
+        GSList *layouts = get_dummy_layouts(notifications);
+        struct colored_layout *cl = layouts->data;
+        struct dimensions dim = calculate_dimensions(layouts);
+        int measured_width = cl->layout_width;
+        ASSERT(measured_width > 0);
+
+        cairo_surface_t *image_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+        layout_render(image_surface, cl, NULL, dim, true, true);
+        ASSERT_EQ(measured_width, cl->layout_width);
+
+        g_slist_free_full(layouts, free_colored_layout);
+        g_slist_free_full(notifications, free_dummy_notification);
+        cairo_surface_destroy(image_surface);
+        output = &dummy_output;
+        settings.width = original_width;
+        settings.height = original_height;
+
+        PASS();
+}
+
+TEST test_layout_limits_text_to_visible_part(void)
+{
+        struct length original_width = settings.width;
+        int original_height = settings.height;
+        settings.width.min = 300;
+        settings.width.max = 300;
+        settings.height = 100;
+
+        struct output wide_output = dummy_output;
+        wide_output.get_active_screen = wide_screen;
+        output = &wide_output;
+
+        struct notification *n = test_notification_uninitialized("long");
+        GString *body = g_string_new(NULL);
+        for (int i = 0; i < 2000; i++)
+                g_string_append(body, "The quick brown fox jumps over the lazy dog.\n");
+        g_free(n->body);
+        n->body = g_string_free(body, false);
+        notification_init(n);
+        n->word_wrap = true;
+
+        PangoEllipsizeMode modes[] = { PANGO_ELLIPSIZE_END, PANGO_ELLIPSIZE_MIDDLE };
+        for (int i = 0; i < G_N_ELEMENTS(modes); i++) {
+                n->ellipsize = modes[i];
+
+                struct colored_layout *cl = layout_from_notification(c, n);
+                calculate_notification_dimensions(cl, 1);
+
+                const char *text;
+                PangoAttrList *attr;
+                notification_get_markup(n, &text, &attr);
+                ASSERT(cl->text_length > 0);
+                ASSERT(cl->text_length < strlen(text));
+
+                // Shaping the whole text gives the same result
+                int w, h, full_w, full_h;
+                get_text_size(cl->l, &w, &h, 1);
+                pango_layout_set_text(cl->l, text, -1);
+                get_text_size(cl->l, &full_w, &full_h, 1);
+                ASSERT_EQ(full_w, w);
+                ASSERT_EQ(full_h, h);
+
+                free_colored_layout(cl);
+        }
+
+        notification_unref(n);
+        output = &dummy_output;
+        settings.width = original_width;
+        settings.height = original_height;
+
+        PASS();
+}
+
+TEST test_layout_limits_text_of_single_paragraph(void)
+{
+        struct length original_width = settings.width;
+        int original_height = settings.height;
+        settings.width.min = 300;
+        settings.width.max = 300;
+        settings.height = 100;
+
+        struct output wide_output = dummy_output;
+        wide_output.get_active_screen = wide_screen;
+        output = &wide_output;
+
+        struct notification *n = test_notification_uninitialized("long");
+        GString *body = g_string_new(NULL);
+        for (int i = 0; i < 2000; i++)
+                g_string_append(body, "The quick brown fox jumps over the lazy dog. ");
+        g_free(n->body);
+        n->body = g_strdup(body->str);
+        notification_init(n);
+        n->word_wrap = true;
+        n->ellipsize = PANGO_ELLIPSIZE_MIDDLE;
+
+        struct colored_layout *cl = layout_from_notification(c, n);
+        calculate_notification_dimensions(cl, 1);
+
+        const char *text;
+        PangoAttrList *attr;
+        notification_get_markup(n, &text, &attr);
+
+        // Only the start and the end of the paragraph are visible
+        ASSERT(cl->text_length > 0);
+        ASSERT(cl->text_tail_start > cl->text_length);
+        ASSERT_EQ((int)strlen(text), cl->text_tail_end);
+
+        // Shaping the whole text gives the same result
+        int w, h, full_w, full_h;
+        get_text_size(cl->l, &w, &h, 1);
+        pango_layout_set_text(cl->l, text, -1);
+        pango_layout_set_attributes(cl->l, attr);
+        get_text_size(cl->l, &full_w, &full_h, 1);
+        ASSERT_EQ(full_w, w);
+        ASSERT_EQ(full_h, h);
+
+        // Smaller text fits more than estimated, so keep all of it
+        g_free(n->text_to_render);
+        n->text_to_render = g_strconcat("<small>", body->str, "</small>", NULL);
+        layout_set_markup(cl, n);
+        calculate_notification_dimensions(cl, 1);
+        ASSERT_EQ(-1, cl->text_length);
+        ASSERT_EQ(-1, cl->text_tail_start);
+
+        free_colored_layout(cl);
+        g_string_free(body, true);
+        notification_unref(n);
+        output = &dummy_output;
+        settings.width = original_width;
+        settings.height = original_height;
+
+        PASS();
+}
+
+TEST test_layout_render_caches_backgrounds(void)
+{
+        int original_height = settings.height;
+        int original_gap_size = settings.gap_size;
+        settings.height = get_small_max_height();
+        settings.gap_size = 10;
+        background_cache_clear();
+
+        GSList *notifications = get_dummy_notifications(3);
+        GSList *layouts = get_dummy_layouts(notifications);
+        struct dimensions dim = calculate_dimensions(layouts);
+
+        cairo_surface_t *image_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, dim.w, dim.h);
+        for (GSList *iter = layouts; iter; iter = iter->next)
+                dim = layout_render(image_surface, iter->data, NULL, dim, true, true);
+
+        // With gaps all the notifications look the same
+        ASSERT_EQ(1, g_queue_get_length(&background_cache));
+
+        background_cache_clear();
+        g_slist_free_full(layouts, free_colored_layout);
+        g_slist_free_full(notifications, free_dummy_notification);
+        cairo_surface_destroy(image_surface);
+        settings.gap_size = original_gap_size;
+        settings.height = original_height;
+
+        PASS();
+}
+
+TEST test_layout_fits_progress_update(void)
+{
+        struct notification *n = test_notification("test", 10);
+        n->progress = 10;
+        g_free(n->text_to_render);
+        n->text_to_render = g_strdup("");
+        struct colored_layout *cl = layout_from_notification(c, n);
+
+        struct notification *update = test_notification("test", 10);
+        update->progress = 20;
+        ASSERT(layout_fits(cl, update, false));
+
+        // the progress bar disappears
+        update->progress = -1;
+        ASSERT_FALSE(layout_fits(cl, update, false));
+
+        update->progress = 20;
+        update->icon_position = ICON_TOP;
+        ASSERT_FALSE(layout_fits(cl, update, false));
+
+        free_colored_layout(cl);
+        notification_unref(n);
+        notification_unref(update);
+        PASS();
+}
+
+static void headless_setup(const char *screen, const char *scale)
+{
+        g_setenv("DUNST_HEADLESS", "1", true);
+        if (screen)
+                g_setenv("DUNST_HEADLESS_SCREEN", screen, true);
+        if (scale)
+                g_setenv("DUNST_HEADLESS_SCALE", scale, true);
+        output = output_create(false);
+        win = output->win_create();
+        queues_init();
+}
+
+static void headless_teardown(void)
+{
+        last_frame_clear();
+        output->win_destroy(win);
+        output->deinit();
+        queues_teardown();
+        g_unsetenv("DUNST_HEADLESS");
+        g_unsetenv("DUNST_HEADLESS_SCREEN");
+        g_unsetenv("DUNST_HEADLESS_SCALE");
+        output = &dummy_output;
+        win = NULL;
+}
+
+TEST test_draw_headless(void)
+{
+        headless_setup("800x600", NULL);
+
+        ASSERT_EQ(800, output->get_active_screen()->w);
+        ASSERT_EQ(600, output->get_active_screen()->h);
+
+        queues_notification_insert(test_notification("headless", 10));
+        queues_update(STATUS_NORMAL, time_monotonic_now());
+
+        draw();
+        ASSERT_EQ(1, headless_frame_count());
+        cairo_surface_t *frame = headless_last_frame();
+        ASSERT(frame);
+        ASSERT(cairo_image_surface_get_width(frame) > 0);
+        ASSERT(cairo_image_surface_get_height(frame) > 0);
+
+        draw();
+        ASSERT_EQ(2, headless_frame_count());
+
+        headless_teardown();
+
+        PASS();
+}
+
+TEST test_draw_headless_dpi_change(void)
+{
+        headless_setup(NULL, "1");
+
+        queues_notification_insert(test_notification("dpi", 10));
+        queues_update(STATUS_NORMAL, time_monotonic_now());
+
+        draw();
+        GSList *layouts = last_frame.layouts;
+        draw();
+        ASSERT_EQ(layouts, last_frame.layouts);
+
+        // Like moving to a monitor with another resolution
+        struct screen_info *scr = (struct screen_info *)output->get_active_screen();
+        scr->dpi *= 2;
+        draw();
+        ASSERT(layouts != last_frame.layouts);
+        ASSERT_EQ(scr->dpi, last_frame.dpi);
+
+        headless_teardown();
+
+        PASS();
+}
+
+TEST test_draw_headless_hides_overflow(void)
+{
+        int limit = settings.notification_limit;
+        bool indicate_hidden = settings.indicate_hidden;
+        settings.notification_limit = 0;
+        settings.indicate_hidden = true;
+
+        headless_setup("800x100", "1");
+
+        for (int i = 0; i < 50; i++)
+                queues_notification_insert(test_notification("overflow", 10));
+        queues_update(STATUS_NORMAL, time_monotonic_now());
+        ASSERT_EQ(50, queues_length_displayed());
+
+        draw();
+        int laid_out = g_slist_length(last_frame.layouts);
+        struct colored_layout *xmore = g_slist_last(last_frame.layouts)->data;
+        ASSERT(xmore->is_xmore);
+        ASSERT(laid_out < 50);
+        ASSERT_EQ(50 - (laid_out - 1), last_frame.hidden);
+
+        // Another frame reuses the layouts of the notifications on the screen
+        GSList *layouts = last_frame.layouts;
+        draw();
+        ASSERT_EQ(layouts, last_frame.layouts);
+
+        headless_teardown();
+        settings.notification_limit = limit;
+        settings.indicate_hidden = indicate_hidden;
+
+        PASS();
+}
+
 SUITE(suite_draw)
 {
         output = &dummy_output;
@@ -315,5 +635,13 @@ SUITE(suite_draw)
                         RUN_TEST(test_calculate_dimensions_height_gaps);
                         RUN_TEST(test_layout_render_no_gaps);
                         RUN_TEST(test_layout_render_gaps);
+                        RUN_TEST(test_layout_render_reuses_measured_layout);
+                        RUN_TEST(test_layout_render_caches_backgrounds);
+                        RUN_TEST(test_layout_fits_progress_update);
+                        RUN_TEST(test_layout_limits_text_to_visible_part);
+                        RUN_TEST(test_layout_limits_text_of_single_paragraph);
+                        RUN_TEST(test_draw_headless);
+                        RUN_TEST(test_draw_headless_dpi_change);
+                        RUN_TEST(test_draw_headless_hides_overflow);
         });
 }
@@ -15,9 +15,30 @@ TEST test_dunst_status(void)
         PASS();
 }
 
+TEST test_scheduler_counts_early_wake_ups(void)
+{
+        scheduler_setup();
+
+        gint64 now = time_monotonic_now();
+        scheduler_set(now + S2US(60), now);
+        ASSERT(g_source_get_ready_time(&scheduler->source) > g_get_monotonic_time());
+
+        // Wake up way before the deadline
+        g_source_set_ready_time(&scheduler->source, 0);
+        g_main_context_iteration(NULL, FALSE);
+
+        ASSERT_EQ(1, scheduler->spurious);
+        ASSERT_EQ(now + S2US(60), scheduler->deadline);
+        ASSERT(g_source_get_ready_time(&scheduler->source) > g_get_monotonic_time());
+
+        scheduler_teardown();
+        PASS();
+}
+
 SUITE(suite_dunst)
 {
         RUN_TEST(test_dunst_status);
+        RUN_TEST(test_scheduler_counts_early_wake_ups);
 }
 
 /* vim: set tabstop=8 shiftwidth=8 expandtab textwidth=0: */
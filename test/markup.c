@@ -99,6 +99,13 @@ TEST test_markup_strip_a(void)
         RUN_TESTp(helper_markup_strip_a, "<a href=\"https://url.com\" invalid</a> link", " link",      NULL);
         RUN_TESTp(helper_markup_strip_a, "<a invalid</a> link",                          " link",      NULL);
 
+        RUN_TESTp(helper_markup_strip_a, "<a href=\"a\">one</a> and <a href=\"b\">two</a>", "one and two", "[one] a\n[two] b");
+        RUN_TESTp(helper_markup_strip_a, "<a>one</a> and <a href=\"b\">two",              "one and two", "[two] b");
+
+        RUN_TESTp(helper_markup_strip_a, "<a href=\"a\">one <a href=\"b\">two</a>",        "one two",       "[one <a href=\"b\">two] a\n[two] b");
+        RUN_TESTp(helper_markup_strip_a, "<a href=\"a\">one <a href=\"b\">two</a> three</a>", "one two three", "[one <a href=\"b\">two] a\n[two three] b");
+        RUN_TESTp(helper_markup_strip_a, "<a>one <a href=\"b\"</a> two",                   "one ",          NULL);
+
         PASS();
 }
 
@@ -146,6 +153,8 @@ TEST test_markup_strip_img(void)
 
         RUN_TESTp(helper_markup_strip_img, "i <img src=\"url.com\" alt=\"invalid\" img",          "i ",            NULL);
 
+        RUN_TESTp(helper_markup_strip_img, "v <img alt=\"one\"> and <img src=\"url.com\"> img",   "v one and [image] img", "[image] url.com");
+
         PASS();
 }
 
@@ -83,33 +83,6 @@ TEST test_notification_is_duplicate(void)
         PASS();
 }
 
-TEST test_notification_replace_single_field(void)
-{
-        char *str = g_malloc(128 * sizeof(char));
-        char *substr = NULL;
-
-        strcpy(str, "Markup %a preserved");
-        substr = strchr(str, '%');
-        notification_replace_single_field(&str, &substr, "and &amp; <i>is</i>", MARKUP_FULL);
-        ASSERT_STR_EQ("Markup and &amp; <i>is</i> preserved", str);
-        ASSERT_EQ(26, substr - str);
-
-        strcpy(str, "Markup %a escaped");
-        substr = strchr(str, '%');
-        notification_replace_single_field(&str, &substr, "and & <i>is</i>", MARKUP_NO);
-        ASSERT_STR_EQ("Markup and &amp; &lt;i&gt;is&lt;/i&gt; escaped", str);
-        ASSERT_EQ(38, substr - str);
-
-        strcpy(str, "Markup %a");
-        substr = strchr(str, '%');
-        notification_replace_single_field(&str, &substr, "<i>is removed</i> and & escaped", MARKUP_STRIP);
-        ASSERT_STR_EQ("Markup is removed and &amp; escaped", str);
-        ASSERT_EQ(35, substr - str);
-
-        g_free(str);
-        PASS();
-}
-
 TEST test_notification_referencing(void)
 {
         struct notification *n = notification_create();
@@ -229,18 +202,96 @@ TEST test_notification_maxlength(void)
         PASS();
 }
 
+TEST test_notification_get_markup(void)
+{
+        struct notification *n = test_notification("markup", 10);
+        const char *text, *text_again;
+        PangoAttrList *attrs, *attrs_again;
+
+        n->text_to_render = g_strdup("<b>bold</b> text");
+        notification_get_markup(n, &text, &attrs);
+        ASSERT_STR_EQ("bold text", text);
+        ASSERT(attrs);
+
+        // Same text, but a new string: the cached result is returned
+        g_free(n->text_to_render);
+        n->text_to_render = g_strdup("<b>bold</b> text");
+        notification_get_markup(n, &text_again, &attrs_again);
+        ASSERT_EQ(text, text_again);
+        ASSERT_EQ(attrs, attrs_again);
+
+        g_free(n->text_to_render);
+        n->text_to_render = g_strdup("<b>broken text");
+        notification_get_markup(n, &text, &attrs);
+        ASSERT_STR_EQ("broken text", text);
+        ASSERT_FALSE(attrs);
+        ASSERT(n->markup_failed);
+
+        // Valid markup isn't parsed anymore, once the message failed
+        g_free(n->text_to_render);
+        n->text_to_render = g_strdup("<i>text</i>");
+        notification_get_markup(n, &text, &attrs);
+        ASSERT_STR_EQ("text", text);
+        ASSERT_FALSE(attrs);
+
+        notification_unref(n);
+        PASS();
+}
+
+TEST test_notification_markup_without_parsing(void)
+{
+        struct notification *n = test_notification("plain", 10);
+        n->format = "<b>%s</b> %b";
+        n->markup = MARKUP_NO;
+        g_free(n->body);
+        n->body = g_strdup("<i>no</i> & markup ");
+
+        notification_format_message(n);
+        ASSERT(n->msg_text);
+        ASSERT_STR_EQ("plain <i>no</i> & markup", n->msg_text);
+
+        notification_update_text_to_render(n);
+        const char *text;
+        PangoAttrList *attrs;
+        notification_get_markup(n, &text, &attrs);
+
+        char *parsed;
+        ASSERT(pango_parse_markup(n->text_to_render, -1, 0, NULL, &parsed, NULL, NULL));
+        ASSERT_STR_EQ(parsed, text);
+        g_free(parsed);
+
+        // Only the summary is bold
+        PangoAttrIterator *iter = pango_attr_list_get_iterator(attrs);
+        gint start, end;
+        pango_attr_iterator_range(iter, &start, &end);
+        ASSERT_EQ(0, start);
+        ASSERT_EQ(strlen("plain"), end);
+        ASSERT(pango_attr_iterator_get(iter, PANGO_ATTR_WEIGHT));
+        ASSERT(pango_attr_iterator_next(iter));
+        ASSERT_FALSE(pango_attr_iterator_get(iter, PANGO_ATTR_WEIGHT));
+        pango_attr_iterator_destroy(iter);
+
+        // Markup in the body has to be parsed
+        n->markup = MARKUP_FULL;
+        notification_format_message(n);
+        ASSERT_FALSE(n->msg_text);
+
+        notification_unref(n);
+        PASS();
+}
 
 SUITE(suite_notification)
 {
         cmdline_load(0, NULL);
 
         RUN_TEST(test_notification_is_duplicate);
-        RUN_TEST(test_notification_replace_single_field);
         RUN_TEST(test_notification_referencing);
         RUN_TEST(test_notification_icon_scaling_toosmall);
         RUN_TEST(test_notification_icon_scaling_toolarge);
         RUN_TEST(test_notification_icon_scaling_notconfigured);
         RUN_TEST(test_notification_icon_scaling_notneeded);
+        RUN_TEST(test_notification_get_markup);
+        RUN_TEST(test_notification_markup_without_parsing);
 
         // TEST notification_format_message
         struct notification *a = notification_create();
@@ -598,6 +598,61 @@ TEST test_datachange_ttl(void)
         PASS();
 }
 
+TEST test_datachange_coalesced(void)
+{
+        gint64 age_threshold = settings.show_age_threshold;
+        struct notification *n;
+        queues_init();
+        gint64 cur_time = 0;
+
+        settings.show_age_threshold = -1;
+        settings.timer_slack = 0;
+
+        n = test_notification("n1", 11);
+        n->timestamp = cur_time;
+        queues_notification_insert(n);
+
+        n = test_notification("n2", 13);
+        n->timestamp = cur_time;
+        queues_notification_insert(n);
+
+        queues_update(STATUS_NORMAL, cur_time);
+        ASSERT_EQm("Without a slack, the first timeout has to be used",
+               S2US(11), queues_get_next_datachange_coalesced(STATUS_NORMAL, cur_time));
+
+        settings.timer_slack = S2US(5);
+        ASSERT_EQm("Both timeouts have to be merged at the next multiple of the slack",
+               S2US(15), queues_get_next_datachange_coalesced(STATUS_NORMAL, cur_time));
+        ASSERT_EQm("The exact timeouts must not be affected by the slack",
+               S2US(11), queues_get_next_datachange(cur_time));
+
+        cur_time = S2US(1);
+        ASSERT_EQm("The notifications don't time out while idle, only check once per slack",
+               S2US(10), queues_get_next_datachange_coalesced(STATUS_IDLE, cur_time));
+        ASSERT_EQm("Being idle doesn't count while fullscreen",
+               S2US(15), queues_get_next_datachange_coalesced(STATUS_FSIDLE, cur_time));
+
+        queues_teardown();
+
+        queues_init();
+        settings.show_age_threshold = S2US(0);
+
+        n = test_notification("n3", 0);
+        n->timestamp = cur_time;
+        queues_notification_insert(n);
+        queues_update(STATUS_NORMAL, cur_time);
+
+        ASSERT_EQm("The age ticks have to be aligned to the slack",
+               S2US(5), queues_get_next_datachange_coalesced(STATUS_NORMAL, cur_time));
+        ASSERTm("The age must not get updated while idle",
+               queues_get_next_datachange_coalesced(STATUS_IDLE, cur_time) < 0);
+
+        settings.timer_slack = 0;
+        settings.show_age_threshold = age_threshold;
+        queues_teardown();
+        PASS();
+}
+
 TEST test_queue_stacking(void)
 {
         settings.stack_duplicates = true;
@@ -1096,6 +1151,7 @@ SUITE(suite_queues)
         RUN_TEST(test_datachange_agethreshold_at_second);
         RUN_TEST(test_datachange_queues);
         RUN_TEST(test_datachange_ttl);
+        RUN_TEST(test_datachange_coalesced);
         RUN_TEST(test_queue_history_clear);
         RUN_TEST(test_queue_history_overfull);
         RUN_TEST(test_queue_history_pushall);